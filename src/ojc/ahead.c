@@ -0,0 +1,193 @@
+/* ahead.c
+ * Copyright (c) 2014, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ahead.h"
+
+typedef struct _AheadBuf {
+    char	*data;
+    ssize_t	len;	// bytes read or -1 on error
+    size_t	pos;	// bytes already copied out
+} *AheadBuf;
+
+struct _Ahead {
+    pthread_t		thread;
+    pthread_mutex_t	lock;
+    pthread_cond_t	ready_cond;
+    pthread_cond_t	free_cond;
+    AheadRead		rf;
+    void		*src;
+    bool		cancel;
+    bool		stop;
+    int			err;
+    int			head;	// next buffer for the parser
+    int			tail;	// next buffer for the thread
+    int			cnt;	// buffers filled and not used yet
+    char		*mem;
+    struct _AheadBuf	bufs[AHEAD_BUF_CNT];
+};
+
+static void*
+ahead_loop(void *arg) {
+    Ahead	ah = (Ahead)arg;
+    AheadBuf	b;
+    ssize_t	cnt;
+    int		err;
+
+    // Only a read can be canceled so the lock is never held when canceled.
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    while (true) {
+	pthread_mutex_lock(&ah->lock);
+	while (!ah->stop && AHEAD_BUF_CNT == ah->cnt) {
+	    pthread_cond_wait(&ah->free_cond, &ah->lock);
+	}
+	if (ah->stop) {
+	    pthread_mutex_unlock(&ah->lock);
+	    break;
+	}
+	b = &ah->bufs[ah->tail];
+	pthread_mutex_unlock(&ah->lock);
+
+	if (ah->cancel) {
+	    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+	}
+	cnt = ah->rf(ah->src, b->data, AHEAD_BUF_SIZE);
+	err = errno;
+	if (ah->cancel) {
+	    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+	}
+	pthread_mutex_lock(&ah->lock);
+	b->len = cnt;
+	b->pos = 0;
+	if (0 > cnt) {
+	    ah->err = err;
+	}
+	ah->tail = (ah->tail + 1) % AHEAD_BUF_CNT;
+	ah->cnt++;
+	pthread_cond_signal(&ah->ready_cond);
+	pthread_mutex_unlock(&ah->lock);
+	if (0 >= cnt) {
+	    break;
+	}
+    }
+    return NULL;
+}
+
+Ahead
+_ojc_ahead_create(AheadRead rf, void *src, bool cancel) {
+    Ahead	ah;
+    int		i;
+
+    if (NULL == (ah = (Ahead)calloc(1, sizeof(struct _Ahead)))) {
+	return NULL;
+    }
+    if (NULL == (ah->mem = (char*)malloc(AHEAD_BUF_CNT * AHEAD_BUF_SIZE))) {
+	free(ah);
+	return NULL;
+    }
+    for (i = 0; i < AHEAD_BUF_CNT; i++) {
+	ah->bufs[i].data = ah->mem + i * AHEAD_BUF_SIZE;
+    }
+    ah->rf = rf;
+    ah->src = src;
+    ah->cancel = cancel;
+    pthread_mutex_init(&ah->lock, NULL);
+    pthread_cond_init(&ah->ready_cond, NULL);
+    pthread_cond_init(&ah->free_cond, NULL);
+    if (0 != pthread_create(&ah->thread, NULL, ahead_loop, ah)) {
+	pthread_cond_destroy(&ah->free_cond);
+	pthread_cond_destroy(&ah->ready_cond);
+	pthread_mutex_destroy(&ah->lock);
+	free(ah->mem);
+	free(ah);
+	return NULL;
+    }
+    return ah;
+}
+
+ssize_t
+_ojc_ahead_read(Ahead ah, char *buf, size_t max) {
+    AheadBuf	b;
+    size_t	cnt;
+
+    pthread_mutex_lock(&ah->lock);
+    while (0 == ah->cnt) {
+	pthread_cond_wait(&ah->ready_cond, &ah->lock);
+    }
+    b = &ah->bufs[ah->head];
+    pthread_mutex_unlock(&ah->lock);
+
+    // The last buffer stays at the head so later reads see the same end.
+    if (0 > b->len) {
+	errno = ah->err;
+	return -1;
+    }
+    if (0 == b->len) {
+	return 0;
+    }
+    cnt = (size_t)b->len - b->pos;
+    if (max < cnt) {
+	cnt = max;
+    }
+    memcpy(buf, b->data + b->pos, cnt);
+    b->pos += cnt;
+    if ((size_t)b->len <= b->pos) {
+	pthread_mutex_lock(&ah->lock);
+	ah->head = (ah->head + 1) % AHEAD_BUF_CNT;
+	ah->cnt--;
+	pthread_cond_signal(&ah->free_cond);
+	pthread_mutex_unlock(&ah->lock);
+    }
+    return (ssize_t)cnt;
+}
+
+void
+_ojc_ahead_destroy(Ahead ah) {
+    if (NULL == ah) {
+	return;
+    }
+    pthread_mutex_lock(&ah->lock);
+    ah->stop = true;
+    pthread_cond_signal(&ah->free_cond);
+    pthread_mutex_unlock(&ah->lock);
+    if (ah->cancel) {
+	pthread_cancel(ah->thread);
+    }
+    pthread_join(ah->thread, NULL);
+    pthread_cond_destroy(&ah->free_cond);
+    pthread_cond_destroy(&ah->ready_cond);
+    pthread_mutex_destroy(&ah->lock);
+    free(ah->mem);
+    free(ah);
+}
@@ -0,0 +1,62 @@
+/* ahead.h
+ * Copyright (c) 2014, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __OJC_AHEAD_H__
+#define __OJC_AHEAD_H__
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+// The read-ahead thread fills up to this many buffers of AHEAD_BUF_SIZE
+// before waiting for the parser to use one.
+#define AHEAD_BUF_CNT	4
+#define AHEAD_BUF_SIZE	0x00010000
+
+typedef struct _Ahead	*Ahead;
+
+// Reads up to size bytes from src. Returns 0 at the end and -1 with errno
+// set on error.
+typedef ssize_t	(*AheadRead)(void *src, char *buf, size_t size);
+
+// Starts a thread that reads from src with rf into a ring of buffers. If
+// cancel is true the thread is canceled when destroyed instead of waiting
+// for a read that might never return such as one from a socket. Returns NULL
+// if the thread can not be started.
+extern Ahead	_ojc_ahead_create(AheadRead rf, void *src, bool cancel);
+
+// Copies up to max bytes of what the thread has read into buf, waiting if
+// nothing has been read yet. Returns 0 at the end and -1 with errno set on
+// error.
+extern ssize_t	_ojc_ahead_read(Ahead ah, char *buf, size_t max);
+
+// Stops the thread and frees the buffers.
+extern void	_ojc_ahead_destroy(Ahead ah);
+
+#endif /* __OJC_AHEAD_H__ */
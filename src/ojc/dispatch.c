@@ -0,0 +1,254 @@
+/* dispatch.c
+ * Copyright (c) 2014, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dispatch.h"
+#include "val.h"
+
+// The queue is a ring with one producer, the parser, and many consumers. A
+// slot is free for position pos when its seq is pos and holds a value when
+// seq is pos + 1. Values are added and taken with atomics alone. The lock
+// and conditions are only used to sleep when the ring is empty or full.
+typedef struct _Slot {
+    atomic_size_t	seq;
+    ojcVal		val;
+} *Slot;
+
+struct _Dispatch {
+    ojcParseCallback	cb;
+    void		*ctx;
+    pthread_t		*threads;
+    size_t		thread_cnt;
+    struct _Slot	*ring;
+    size_t		mask;
+    size_t		tail;	// only used by the producer
+    atomic_size_t	head;
+    atomic_bool		done;
+    atomic_bool		failed;
+    atomic_int		idle;	// consumers waiting for a value
+    atomic_int		full;	// set while the producer waits for a slot
+    pthread_mutex_t	lock;
+    pthread_cond_t	ready_cond;
+    pthread_cond_t	free_cond;
+    struct _ojcErr	err;	// first callback error
+};
+
+static bool
+is_empty(Dispatch d) {
+    size_t	pos = atomic_load(&d->head);
+
+    return atomic_load(&d->ring[pos & d->mask].seq) != pos + 1;
+}
+
+static bool
+is_full(Dispatch d) {
+    return atomic_load(&d->ring[d->tail & d->mask].seq) != d->tail;
+}
+
+// Returns the next value or NULL if the ring is empty.
+static ojcVal
+take(Dispatch d) {
+    Slot	s;
+    size_t	pos = atomic_load(&d->head);
+    size_t	seq;
+    ojcVal	val;
+
+    while (true) {
+	s = &d->ring[pos & d->mask];
+	seq = atomic_load(&s->seq);
+	if (seq == pos + 1) {
+	    if (atomic_compare_exchange_weak(&d->head, &pos, pos + 1)) {
+		break;
+	    }
+	} else if (seq < pos + 1) {
+	    return NULL;
+	} else {
+	    pos = atomic_load(&d->head);
+	}
+    }
+    val = s->val;
+    atomic_store(&s->seq, pos + d->mask + 1);
+    if (0 < atomic_load(&d->full)) {
+	pthread_mutex_lock(&d->lock);
+	pthread_cond_signal(&d->free_cond);
+	pthread_mutex_unlock(&d->lock);
+    }
+    return val;
+}
+
+static void
+set_error(Dispatch d, ojcErr err) {
+    pthread_mutex_lock(&d->lock);
+    if (!atomic_load(&d->failed)) {
+	d->err = *err;
+	atomic_store(&d->failed, true);
+    }
+    pthread_mutex_unlock(&d->lock);
+}
+
+static void*
+work(void *arg) {
+    Dispatch		d = (Dispatch)arg;
+    struct _ojcErr	err;
+    ojcVal		val;
+
+    while (true) {
+	if (NULL == (val = take(d))) {
+	    pthread_mutex_lock(&d->lock);
+	    atomic_fetch_add(&d->idle, 1);
+	    while (is_empty(d) && !atomic_load(&d->done)) {
+		pthread_cond_wait(&d->ready_cond, &d->lock);
+	    }
+	    atomic_fetch_sub(&d->idle, 1);
+	    pthread_mutex_unlock(&d->lock);
+	    if (is_empty(d) && atomic_load(&d->done)) {
+		break;
+	    }
+	    continue;
+	}
+	// Once a callback fails the rest are destroyed without being seen
+	// just as if the parse had stopped.
+	if (atomic_load(&d->failed)) {
+	    ojc_destroy(val);
+	    continue;
+	}
+	ojc_err_init(&err);
+	if (d->cb(&err, val, d->ctx)) {
+	    ojc_destroy(val);
+	}
+	if (OJC_OK != err.code) {
+	    set_error(d, &err);
+	}
+    }
+    return NULL;
+}
+
+Dispatch
+_ojc_dispatch_create(ojcParseCallback cb, void *ctx, size_t thread_cnt, size_t queue_size) {
+    Dispatch	d;
+    size_t	size = 2;
+    size_t	i;
+
+    while (size < queue_size) {
+	size <<= 1;
+    }
+    if (NULL == (d = (Dispatch)calloc(1, sizeof(struct _Dispatch)))) {
+	return NULL;
+    }
+    if (NULL == (d->ring = (Slot)calloc(size, sizeof(struct _Slot))) ||
+	NULL == (d->threads = (pthread_t*)malloc(sizeof(pthread_t) * thread_cnt))) {
+	free(d->ring);
+	free(d);
+	return NULL;
+    }
+    for (i = 0; i < size; i++) {
+	atomic_init(&d->ring[i].seq, i);
+    }
+    d->cb = cb;
+    d->ctx = ctx;
+    d->mask = size - 1;
+    ojc_err_init(&d->err);
+    pthread_mutex_init(&d->lock, NULL);
+    pthread_cond_init(&d->ready_cond, NULL);
+    pthread_cond_init(&d->free_cond, NULL);
+    for (d->thread_cnt = 0; d->thread_cnt < thread_cnt; d->thread_cnt++) {
+	if (0 != pthread_create(&d->threads[d->thread_cnt], NULL, work, d)) {
+	    break;
+	}
+    }
+    if (0 == d->thread_cnt) {
+	pthread_cond_destroy(&d->free_cond);
+	pthread_cond_destroy(&d->ready_cond);
+	pthread_mutex_destroy(&d->lock);
+	free(d->threads);
+	free(d->ring);
+	free(d);
+	return NULL;
+    }
+    return d;
+}
+
+bool
+_ojc_dispatch_push(Dispatch d, ojcErr err, ojcVal val) {
+    Slot	s;
+
+    if (atomic_load(&d->failed)) {
+	ojc_destroy(val);
+	pthread_mutex_lock(&d->lock);
+	*err = d->err;
+	pthread_mutex_unlock(&d->lock);
+	return false;
+    }
+    if (is_full(d)) {
+	pthread_mutex_lock(&d->lock);
+	atomic_store(&d->full, 1);
+	while (is_full(d)) {
+	    pthread_cond_wait(&d->free_cond, &d->lock);
+	}
+	atomic_store(&d->full, 0);
+	pthread_mutex_unlock(&d->lock);
+    }
+    s = &d->ring[d->tail & d->mask];
+    s->val = val;
+    atomic_store(&s->seq, d->tail + 1);
+    d->tail++;
+    if (0 < atomic_load(&d->idle)) {
+	pthread_mutex_lock(&d->lock);
+	pthread_cond_signal(&d->ready_cond);
+	pthread_mutex_unlock(&d->lock);
+    }
+    return true;
+}
+
+void
+_ojc_dispatch_finish(Dispatch d, ojcErr err) {
+    size_t	i;
+
+    atomic_store(&d->done, true);
+    pthread_mutex_lock(&d->lock);
+    pthread_cond_broadcast(&d->ready_cond);
+    pthread_mutex_unlock(&d->lock);
+    for (i = 0; i < d->thread_cnt; i++) {
+	pthread_join(d->threads[i], NULL);
+    }
+    if (OJC_OK == err->code && atomic_load(&d->failed)) {
+	*err = d->err;
+    }
+    pthread_cond_destroy(&d->free_cond);
+    pthread_cond_destroy(&d->ready_cond);
+    pthread_mutex_destroy(&d->lock);
+    free(d->threads);
+    free(d->ring);
+    free(d);
+}
@@ -0,0 +1,56 @@
+/* dispatch.h
+ * Copyright (c) 2014, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __OJC_DISPATCH_H__
+#define __OJC_DISPATCH_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ojc.h"
+
+typedef struct _Dispatch	*Dispatch;
+
+// Starts thread_cnt threads that call cb with values passed to
+// _ojc_dispatch_push(). Up to queue_size values, rounded up to a power of
+// two, wait for a thread before the parser waits. Returns NULL if the
+// threads can not be started.
+extern Dispatch	_ojc_dispatch_create(ojcParseCallback cb, void *ctx, size_t thread_cnt, size_t queue_size);
+
+// Queues val for a callback thread, waiting if the queue is full. If a
+// callback has set an error, val is destroyed, the error is copied to err,
+// and false is returned.
+extern bool	_ojc_dispatch_push(Dispatch d, ojcErr err, ojcVal val);
+
+// Waits for the queued values to be handled, stops the threads, and frees
+// d. If err is not set the first error from a callback is copied to it.
+extern void	_ojc_dispatch_finish(Dispatch d, ojcErr err);
+
+#endif /* __OJC_DISPATCH_H__ */
@@ -0,0 +1,122 @@
+/* index.c
+ * Copyright (c) 2014, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "index.h"
+
+const uint8_t	simd_char_class[256] = {
+    ['"'] = CC_QUOTE,
+    ['\\'] = CC_BSLASH,
+    [' '] = CC_WHITE,
+    ['\t'] = CC_WHITE,
+    ['\n'] = CC_WHITE,
+    ['\r'] = CC_WHITE,
+    ['\f'] = CC_WHITE,
+    ['{'] = CC_OP,
+    ['}'] = CC_OP,
+    ['['] = CC_OP,
+    [']'] = CC_OP,
+    [':'] = CC_OP,
+    [','] = CC_OP,
+    ['/'] = CC_SLASH,
+};
+
+void
+ojc_index_init(Index index, const char *str, const char *end) {
+    index->end = end;
+    ojc_index_restart(index, str);
+}
+
+// Starts indexing over from a point known to be outside of a string and not
+// in the middle of a number or word.
+void
+ojc_index_restart(Index index, const char *from) {
+    index->head = index->pos;
+    index->tail = index->pos;
+    index->base = from;
+    index->next = from;
+    index->escaped = 0;
+    index->in_str = 0;
+    index->scalar = 0;
+}
+
+// Indexes the next chunk. Returns false if there is nothing left to index.
+bool
+ojc_index_build(Index index) {
+    const char		*p = index->next;
+    const char		*end = p + INDEX_CHUNK;
+    uint16_t		*t = index->pos;
+    struct _Block	b;
+    char		pad[SIMD_BLOCK];
+    uint64_t		escaped;
+    uint64_t		quote;
+    uint64_t		in_str;
+    uint64_t		scalar;
+    uint64_t		entries;
+    int			off;
+
+    if (index->end <= p) {
+	return false;
+    }
+    if (index->end < end) {
+	end = index->end;
+    }
+    index->base = p;
+    for (off = 0; p < end; p += SIMD_BLOCK, off += SIMD_BLOCK) {
+	if (end - p < SIMD_BLOCK) {
+	    memset(pad, ' ', sizeof(pad));
+	    memcpy(pad, p, end - p);
+	    simd_classify(pad, &b);
+	} else {
+	    simd_classify(p, &b);
+	}
+	escaped = simd_escaped(b.bslash, &index->escaped);
+	quote = b.quote & ~escaped;
+	// Includes the opening quote but not the closing quote.
+	in_str = simd_prefix_xor(quote) ^ index->in_str;
+	index->in_str = (uint64_t)((int64_t)in_str >> 63);
+	scalar = ~(b.white | b.op | b.slash | quote | in_str);
+	entries = ((b.op | b.slash) & ~in_str) |
+	    quote |
+	    (((b.bslash & ~escaped) | b.ctrl) & in_str) |
+	    (scalar & ~((scalar << 1) | index->scalar));
+	index->scalar = scalar >> 63;
+	for (; 0 != entries; entries &= entries - 1) {
+	    *t++ = (uint16_t)(off + __builtin_ctzll(entries));
+	}
+    }
+    index->next = end;
+    index->head = index->pos;
+    index->tail = t;
+
+    return true;
+}
@@ -0,0 +1,92 @@
+/* index.h
+ * Copyright (c) 2014, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __OJC_INDEX_H__
+#define __OJC_INDEX_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "simd.h"
+
+// Number of bytes indexed in each pass. Offsets are stored relative to the
+// start of the chunk so 16 bits is enough.
+#define INDEX_CHUNK	0x00001000
+
+// Positions of the structural characters, quotes, backslashes and control
+// characters in strings, comment starts, and starts of numbers and words in a chunk of a string
+// being parsed. The parser walks from one entry to the next instead of
+// looking at every character.
+typedef struct _Index {
+    uint16_t	pos[INDEX_CHUNK];
+    uint16_t	*head;		// next entry to return
+    uint16_t	*tail;		// one past the last entry
+    const char	*base;		// start of the current chunk
+    const char	*next;		// start of the next chunk
+    const char	*end;		// end of the string
+    uint64_t	escaped;	// carry for escaped characters
+    uint64_t	in_str;		// all ones if a string continues into the next block
+    uint64_t	scalar;		// 1 if the last character of the previous block was part of a scalar
+} *Index;
+
+extern void	ojc_index_init(Index index, const char *str, const char *end);
+extern void	ojc_index_restart(Index index, const char *from);
+extern bool	ojc_index_build(Index index);
+
+// Returns the next entry or NULL if all the input has been indexed and
+// returned.
+static inline const char*
+ojc_index_next(Index index) {
+    while (index->tail <= index->head) {
+	if (!ojc_index_build(index)) {
+	    return NULL;
+	}
+    }
+    return index->base + *index->head++;
+}
+
+// Returns the next entry without moving past it if it is in the current
+// chunk.
+static inline const char*
+ojc_index_peek(Index index) {
+    if (index->head < index->tail) {
+	return index->base + *index->head;
+    }
+    return NULL;
+}
+
+// True if the character after a scalar is one that would have been indexed or
+// is white space.
+static inline bool
+ojc_index_delim(char c) {
+    return 0 != (simd_char_class[(uint8_t)c] & (CC_QUOTE | CC_WHITE | CC_OP | CC_SLASH));
+}
+
+#endif /* __OJC_INDEX_H__ */
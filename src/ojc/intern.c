@@ -0,0 +1,147 @@
+/* intern.c
+ * Copyright (c) 2014, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+
+#define BUCKET_CNT	4096
+#define BUCKET_MASK	(BUCKET_CNT - 1)
+
+typedef struct _Sym {
+    struct _Sym	*next;
+    uint32_t	hash;
+    uint16_t	len;
+    char	str[];
+} *Sym;
+
+// Lookups do not lock. An entry is complete before it is published at the
+// head of a bucket and entries are never changed or removed after that so
+// readers only need the acquire load of the head. Adds are serialized with
+// the busy flag.
+static _Atomic(Sym)	buckets[BUCKET_CNT];
+static atomic_flag	busy = ATOMIC_FLAG_INIT;
+static atomic_int	sym_cnt = 0;
+
+// FNV-1a
+static inline uint32_t
+hash_key(const char *key, int len) {
+    const uint8_t	*k = (const uint8_t*)key;
+    const uint8_t	*end = k + len;
+    uint32_t		h = 2166136261U;
+
+    for (; k < end; k++) {
+	h = (h ^ *k) * 16777619U;
+    }
+    return h;
+}
+
+static Sym
+find(Sym s, const char *key, int len, uint32_t h) {
+    for (; NULL != s; s = s->next) {
+	if (h == s->hash && len == s->len && 0 == memcmp(key, s->str, len)) {
+	    break;
+	}
+    }
+    return s;
+}
+
+const char*
+_ojc_intern_find(const char *key, int len) {
+    uint32_t	h;
+    Sym		s;
+
+    if (INTERN_MAX_LEN < len || 0 == atomic_load_explicit(&sym_cnt, memory_order_acquire)) {
+	return NULL;
+    }
+    h = hash_key(key, len);
+    if (NULL == (s = find(atomic_load_explicit(&buckets[h & BUCKET_MASK], memory_order_acquire), key, len, h))) {
+	return NULL;
+    }
+    return s->str;
+}
+
+const char*
+_ojc_intern(const char *key, int len) {
+    _Atomic(Sym)	*bucket;
+    uint32_t		h;
+    Sym			head;
+    Sym			s;
+
+    if (INTERN_MAX_LEN < len) {
+	return NULL;
+    }
+    h = hash_key(key, len);
+    bucket = &buckets[h & BUCKET_MASK];
+    head = atomic_load_explicit(bucket, memory_order_acquire);
+    if (NULL != (s = find(head, key, len, h))) {
+	return s->str;
+    }
+    while (atomic_flag_test_and_set(&busy)) {
+    }
+    // Look again in case it was added since the first look.
+    s = find(atomic_load_explicit(bucket, memory_order_relaxed), key, len, h);
+    if (NULL == s &&
+	atomic_load_explicit(&sym_cnt, memory_order_relaxed) < INTERN_MAX_CNT &&
+	NULL != (s = (Sym)malloc(sizeof(struct _Sym) + len + 1))) {
+	s->next = atomic_load_explicit(bucket, memory_order_relaxed);
+	s->hash = h;
+	s->len = (uint16_t)len;
+	memcpy(s->str, key, len);
+	s->str[len] = '\0';
+	atomic_store_explicit(bucket, s, memory_order_release);
+	atomic_fetch_add_explicit(&sym_cnt, 1, memory_order_release);
+    }
+    atomic_flag_clear(&busy);
+
+    return NULL == s ? NULL : s->str;
+}
+
+void
+_ojc_intern_cleanup() {
+    Sym	s;
+    Sym	next;
+    int	i;
+
+    while (atomic_flag_test_and_set(&busy)) {
+    }
+    for (i = 0; i < BUCKET_CNT; i++) {
+	for (s = atomic_load_explicit(&buckets[i], memory_order_relaxed); NULL != s; s = next) {
+	    next = s->next;
+	    free(s);
+	}
+	atomic_store_explicit(&buckets[i], NULL, memory_order_relaxed);
+    }
+    atomic_store_explicit(&sym_cnt, 0, memory_order_relaxed);
+    atomic_flag_clear(&busy);
+}
@@ -0,0 +1,54 @@
+/* intern.h
+ * Copyright (c) 2014, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __OJC_INTERN_H__
+#define __OJC_INTERN_H__
+
+#include <stdbool.h>
+
+// Longest key that is interned. Longer keys are copied into each value.
+#define INTERN_MAX_LEN	255
+
+// Once this many keys have been interned new keys are no longer added so
+// keys that are really data such as ids do not grow the table forever.
+#define INTERN_MAX_CNT	65536
+
+// Returns the interned copy of key, adding it if needed, or NULL if it can
+// not be interned. Interned keys are terminated and never change.
+extern const char*	_ojc_intern(const char *key, int len);
+
+// Returns the interned copy of key or NULL if it has not been interned.
+extern const char*	_ojc_intern_find(const char *key, int len);
+
+// Frees the table. Must not be called while any value still has an interned
+// key.
+extern void		_ojc_intern_cleanup(void);
+
+#endif /* __OJC_INTERN_H__ */
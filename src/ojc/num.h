@@ -0,0 +1,96 @@
+/* num.h
+ * Copyright (c) 2014, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __OJC_NUM_H__
+#define __OJC_NUM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Digits are checked and converted eight at a time by treating them as a
+// 64 bit integer. That relies on the first character being the low byte.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define NUM_SWAR	1
+#endif
+
+// Returns true if the eight characters at p are all digits.
+static inline bool
+ojc_num_eight_digits(const char *p) {
+#ifdef NUM_SWAR
+    uint64_t	v;
+
+    memcpy(&v, p, sizeof(v));
+
+    return 0 == (((v & 0xF0F0F0F0F0F0F0F0ULL) |
+		  (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ^
+		 0x3333333333333333ULL);
+#else
+    int	i;
+
+    for (i = 0; i < 8; i++) {
+	if (p[i] < '0' || '9' < p[i]) {
+	    return false;
+	}
+    }
+    return true;
+#endif
+}
+
+// Converts eight digits at p to an integer.
+static inline uint32_t
+ojc_num_parse_eight(const char *p) {
+#ifdef NUM_SWAR
+    uint64_t	v;
+
+    memcpy(&v, p, sizeof(v));
+    v -= 0x3030303030303030ULL;
+    v = (v * 10) + (v >> 8);
+    v = (((v & 0x000000FF000000FFULL) * 0x000F424000000064ULL) +
+	 (((v >> 16) & 0x000000FF000000FFULL) * 0x0000271000000001ULL)) >> 32;
+
+    return (uint32_t)v;
+#else
+    uint32_t	v = 0;
+    int		i;
+
+    for (i = 0; i < 8; i++) {
+	v = v * 10 + (p[i] - '0');
+    }
+    return v;
+#endif
+}
+
+// Returns the double closest to mant * 10^exp10. Falls back to strtod() on
+// the len bytes of str, the text of the number, for the rare cases that can
+// not be decided quickly. str does not have to be terminated.
+extern double	ojc_num_to_double(uint64_t mant, int exp10, bool neg, const char *str, size_t len);
+
+#endif /* __OJC_NUM_H__ */
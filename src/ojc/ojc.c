@@ -28,12 +28,20 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "ojc.h"
 #include "buf.h"
+#include "intern.h"
+#include "parallel.h"
 #include "parse.h"
+#include "reclaim.h"
 #include "val.h"
 
 #define MAX_INDEX	200000000
@@ -61,11 +69,23 @@ static char		hibit_friendly_chars[257] = "\
 11111111111111111111111111111111";
 
 bool		ojc_newline_ok = false;
+bool		ojc_parse_newline_ok = false;
 bool		ojc_word_ok = false;
 bool		ojc_decimal_as_number = false;
 bool		ojc_case_insensitive = false;
 bool		ojc_write_opaque = false;
 bool		ojc_write_end_with_newline = true;
+bool		ojc_intern_keys = false;
+size_t		ojc_read_buf_size = 0x00001000;
+size_t		ojc_read_buf_max = 0x00040000;
+bool		ojc_read_huge_pages = false;
+bool		ojc_read_ring = false;
+bool		ojc_io_uring = false;
+bool		ojc_read_ahead = false;
+size_t		ojc_parse_threads = 0;
+size_t		ojc_reclaim_threads = 1;
+size_t		ojc_callback_threads = 0;
+size_t		ojc_callback_queue = 64;
 
 const char*
 ojc_version() {
@@ -74,7 +94,9 @@ ojc_version() {
 
 void
 ojc_cleanup() {
+    _ojc_reclaim_cleanup();
     _ojc_val_cleanup();
+    _ojc_intern_cleanup();
 }
 
 int
@@ -85,6 +107,33 @@ ojc_destroy(ojcVal val) {
     return 0;
 }
 
+int
+ojc_destroy_async(ojcVal val) {
+    if (NULL != val) {
+	if (OJC_FREE == val->type) {
+	    return OJC_MEMORY_ERR;
+	}
+	_ojc_reclaim(val, ojc_reclaim_threads);
+    }
+    return 0;
+}
+
+// Returns true if json was parsed by splitting a large top level array
+// between ojc_parse_threads threads.
+static bool
+parse_split(ojcErr err, const char *json, size_t len, ojcParseCallback cb, void *ctx, ojcVal *valp) {
+    struct _ojcErr	perr = OJC_ERR_INIT;
+
+    if (!_ojc_parse_split(&perr, json, len, (int)ojc_parse_threads, cb, ctx, valp)) {
+	return false;
+    }
+    if (OJC_OK != perr.code && 0 != err) {
+	err->code = perr.code;
+	memcpy(err->msg, perr.msg, sizeof(perr.msg));
+    }
+    return true;
+}
+
 ojcVal
 ojc_parse_str(ojcErr err, const char *json, ojcParseCallback cb, void *ctx) {
     struct _ParseInfo	pi;
@@ -94,12 +143,73 @@ ojc_parse_str(ojcErr err, const char *json, ojcParseCallback cb, void *ctx) {
 	// Previous call must have failed or err was not initialized.
 	return 0;
     }
+    if (1 < ojc_parse_threads && NULL != json && parse_split(err, json, strlen(json), cb, ctx, &val)) {
+	return val;
+    }
     parse_init(&pi.err, &pi, cb, ctx);
     ojc_reader_init_str(&pi.err, &pi.rd, json);
     if (OJC_OK != pi.err.code) {
 	return 0;
     }
-    ojc_parse(&pi);
+    ojc_parse_indexed(&pi);
+    val = *pi.stack.head;
+    if (OJC_OK != pi.err.code && 0 != err) {
+	err->code = pi.err.code;
+	memcpy(err->msg, pi.err.msg, sizeof(pi.err.msg));
+    }
+    parse_cleanup(&pi);
+
+    return val;
+}
+
+// Unescaped strings and keys are left in json instead of being copied so json
+// must not be changed or freed until the values are destroyed.
+ojcVal
+ojc_parse_borrow(ojcErr err, const char *json, ojcParseCallback cb, void *ctx) {
+    struct _ParseInfo	pi;
+    ojcVal		val;
+
+    if (0 != err && OJC_OK != err->code) {
+	// Previous call must have failed or err was not initialized.
+	return 0;
+    }
+    parse_init(&pi.err, &pi, cb, ctx);
+    pi.borrow = true;
+    ojc_reader_init_str(&pi.err, &pi.rd, json);
+    if (OJC_OK != pi.err.code) {
+	return 0;
+    }
+    ojc_parse_indexed(&pi);
+    val = *pi.stack.head;
+    if (OJC_OK != pi.err.code && 0 != err) {
+	err->code = pi.err.code;
+	memcpy(err->msg, pi.err.msg, sizeof(pi.err.msg));
+    }
+    parse_cleanup(&pi);
+
+    return val;
+}
+
+// Strings are unescaped and terminated in buf, writing over the JSON, so no
+// string or key is copied. buf must not be changed or freed until the values
+// are destroyed.
+ojcVal
+ojc_parse_insitu(ojcErr err, char *buf, size_t len, ojcParseCallback cb, void *ctx) {
+    struct _ParseInfo	pi;
+    ojcVal		val;
+
+    if (0 != err && OJC_OK != err->code) {
+	// Previous call must have failed or err was not initialized.
+	return 0;
+    }
+    parse_init(&pi.err, &pi, cb, ctx);
+    pi.borrow = true;
+    pi.insitu = true;
+    ojc_reader_init_strn(&pi.err, &pi.rd, buf, len);
+    if (OJC_OK != pi.err.code) {
+	return 0;
+    }
+    ojc_parse_indexed(&pi);
     val = *pi.stack.head;
     if (OJC_OK != pi.err.code && 0 != err) {
 	err->code = pi.err.code;
@@ -138,6 +248,72 @@ ojc_parse_strp(ojcErr err, const char **jsonp) {
     return val;
 }
 
+// Maps len bytes of fd followed by at least one zero byte so scanners that
+// stop on a '\0' never touch memory past the mapping even when the file ends
+// on a page boundary in the middle of a word or number. The file is mapped
+// over an anonymous mapping one byte longer. Unmap with unmap_file().
+static char*
+map_file(int fd, size_t len) {
+    char	*map;
+
+    if (MAP_FAILED == (map = (char*)mmap(NULL, len + 1, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0))) {
+	return map;
+    }
+    if (MAP_FAILED == mmap(map, len, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0)) {
+	munmap(map, len + 1);
+	return MAP_FAILED;
+    }
+    madvise(map, len, MADV_SEQUENTIAL);
+
+    return map;
+}
+
+static void
+unmap_file(char *map, size_t len) {
+    munmap(map, len + 1);
+}
+
+// A regular file can be split like a string by mapping it. The rest of the
+// file from the current position is parsed and the file is left at the end.
+static bool
+parse_split_file(ojcErr err, FILE *file, ojcParseCallback cb, void *ctx, ojcVal *valp) {
+    struct stat	st;
+    char	*map;
+    off_t	off;
+    bool	done;
+
+    if (0 != fstat(fileno(file), &st) || !S_ISREG(st.st_mode) || 0 > (off = ftello(file)) || st.st_size <= off) {
+	return false;
+    }
+    if (MAP_FAILED == (map = map_file(fileno(file), (size_t)st.st_size))) {
+	return false;
+    }
+    if ((done = parse_split(err, map + off, (size_t)(st.st_size - off), cb, ctx, valp))) {
+	fseeko(file, 0, SEEK_END);
+    }
+    unmap_file(map, (size_t)st.st_size);
+
+    return done;
+}
+
+// Starts ojc_callback_threads threads to call the each callback of the
+// streaming parsers. If they can not be started the callback is called on
+// the parser thread.
+static void
+dispatch_start(ParseInfo pi) {
+    if (0 < ojc_callback_threads && NULL != pi->each_cb) {
+	pi->dispatch = _ojc_dispatch_create(pi->each_cb, pi->each_ctx, ojc_callback_threads, ojc_callback_queue);
+    }
+}
+
+static void
+dispatch_finish(ParseInfo pi) {
+    if (NULL != pi->dispatch) {
+	_ojc_dispatch_finish(pi->dispatch, &pi->err);
+	pi->dispatch = NULL;
+    }
+}
+
 ojcVal
 ojc_parse_file(ojcErr err, FILE *file, ojcParseCallback cb, void *ctx) {
     struct _ParseInfo	pi;
@@ -147,12 +323,96 @@ ojc_parse_file(ojcErr err, FILE *file, ojcParseCallback cb, void *ctx) {
 	// Previous call must have failed or err was not initialized.
 	return 0;
     }
+    if (1 < ojc_parse_threads && NULL != file && parse_split_file(err, file, cb, ctx, &val)) {
+	return val;
+    }
     parse_init(&pi.err, &pi, cb, ctx);
     ojc_reader_init_stream(err, &pi.rd, file);
     if (OJC_OK != err->code) {
 	return 0;
     }
+    dispatch_start(&pi);
     ojc_parse(&pi);
+    dispatch_finish(&pi);
+    val = *pi.stack.head;
+    if (OJC_OK != pi.err.code && 0 != err) {
+	err->code = pi.err.code;
+	memcpy(err->msg, pi.err.msg, sizeof(pi.err.msg));
+    }
+    parse_cleanup(&pi);
+
+    return val;
+}
+
+// Maps the file at path for reading with map_file(). An empty file is not
+// mapped and leaves *mapp NULL.
+static bool
+map_path(ojcErr err, const char *path, char **mapp, size_t *lenp) {
+    struct stat	st;
+    char	*map = NULL;
+    size_t	len = 0;
+    int		fd;
+
+    if (NULL == path || 0 > (fd = open(path, O_RDONLY))) {
+	if (0 != err) {
+	    err->code = OJC_ARG_ERR;
+	    snprintf(err->msg, sizeof(err->msg), "Failed to open %s. %s.", NULL == path ? "(null)" : path, strerror(errno));
+	}
+	return false;
+    }
+    if (0 != fstat(fd, &st)) {
+	if (0 != err) {
+	    err->code = OJC_ARG_ERR;
+	    snprintf(err->msg, sizeof(err->msg), "Failed to stat %s. %s.", path, strerror(errno));
+	}
+	close(fd);
+	return false;
+    }
+    if (0 < st.st_size) {
+	len = (size_t)st.st_size;
+	if (MAP_FAILED == (map = map_file(fd, len))) {
+	    if (0 != err) {
+		err->code = OJC_MEMORY_ERR;
+		snprintf(err->msg, sizeof(err->msg), "Failed to map %s. %s.", path, strerror(errno));
+	    }
+	    close(fd);
+	    return false;
+	}
+    }
+    close(fd);
+    *mapp = map;
+    *lenp = len;
+
+    return true;
+}
+
+// The file is mapped and parsed in place like a string instead of being read
+// through the reader buffer. Values are copies so the mapping is dropped
+// before returning.
+ojcVal
+ojc_parse_path(ojcErr err, const char *path, ojcParseCallback cb, void *ctx) {
+    struct _ParseInfo	pi;
+    ojcVal		val;
+    char		*map = NULL;
+    size_t		len = 0;
+
+    if (0 != err && OJC_OK != err->code) {
+	// Previous call must have failed or err was not initialized.
+	return 0;
+    }
+    if (!map_path(err, path, &map, &len)) {
+	return 0;
+    }
+    if (1 < ojc_parse_threads && NULL != map && parse_split(err, map, len, cb, ctx, &val)) {
+	unmap_file(map, len);
+	return val;
+    }
+    parse_init(&pi.err, &pi, cb, ctx);
+    ojc_reader_init_strn(&pi.err, &pi.rd, NULL == map ? "" : map, len);
+    ojc_parse_indexed(&pi);
+    if (NULL != map) {
+	unmap_file(map, len);
+    }
     val = *pi.stack.head;
     if (OJC_OK != pi.err.code && 0 != err) {
 	err->code = pi.err.code;
@@ -163,6 +423,38 @@ ojc_parse_file(ojcErr err, FILE *file, ojcParseCallback cb, void *ctx) {
     return val;
 }
 
+// The file is mapped, split into chunks at newlines, and the chunks parsed on
+// several threads so each value must be on one line.
+void
+ojc_parse_file_parallel(ojcErr err, const char *path, int nthreads, ojcParseCallback cb, void *ctx, int flags) {
+    struct _ojcErr	perr = OJC_ERR_INIT;
+    char		*map = NULL;
+    size_t		len = 0;
+
+    if (0 != err && OJC_OK != err->code) {
+	// Previous call must have failed or err was not initialized.
+	return;
+    }
+    if (NULL == cb) {
+	if (0 != err) {
+	    err->code = OJC_ARG_ERR;
+	    snprintf(err->msg, sizeof(err->msg), "A callback is required for a parallel parse.");
+	}
+	return;
+    }
+    if (!map_path(err, path, &map, &len)) {
+	return;
+    }
+    if (NULL != map) {
+	_ojc_parse_parallel(&perr, map, len, nthreads, cb, ctx, 0 == (flags & OJC_UNORDERED));
+	unmap_file(map, len);
+    }
+    if (OJC_OK != perr.code && 0 != err) {
+	err->code = perr.code;
+	memcpy(err->msg, perr.msg, sizeof(perr.msg));
+    }
+}
+
 ojcVal
 ojc_parse_fd(ojcErr err, int socket, ojcParseCallback cb, void *ctx) {
     struct _ParseInfo	pi;
@@ -177,7 +469,9 @@ ojc_parse_fd(ojcErr err, int socket, ojcParseCallback cb, void *ctx) {
     if (OJC_OK != err->code) {
 	return 0;
     }
+    dispatch_start(&pi);
     ojc_parse(&pi);
+    dispatch_finish(&pi);
     val = *pi.stack.head;
     if (OJC_OK != pi.err.code && 0 != err) {
 	err->code = pi.err.code;
@@ -201,7 +495,9 @@ ojc_parse_file_follow(ojcErr err, FILE *file, ojcParseCallback cb, void *ctx) {
     if (OJC_OK != err->code) {
 	return;
     }
+    dispatch_start(&pi);
     ojc_parse(&pi);
+    dispatch_finish(&pi);
     if (OJC_OK != pi.err.code && 0 != err) {
 	err->code = pi.err.code;
 	memcpy(err->msg, pi.err.msg, sizeof(pi.err.msg));
@@ -234,6 +530,210 @@ ojc_parse_reader(ojcErr err, void *src, ojcReadFunc rf, ojcParseCallback cb, voi
     return val;
 }
 
+ojcVal
+ojc_parse_lender(ojcErr err, void *src, ojcLendFunc lend, ojcReleaseFunc release, ojcParseCallback cb, void *ctx) {
+    struct _ParseInfo	pi;
+    ojcVal		val;
+
+    if (0 != err && OJC_OK != err->code) {
+	// Previous call must have failed or err was not initialized.
+	return 0;
+    }
+    parse_init(&pi.err, &pi, cb, ctx);
+    ojc_reader_init_lender(err, &pi.rd, src, lend, release);
+    if (OJC_OK != err->code) {
+	return 0;
+    }
+    ojc_parse(&pi);
+    val = *pi.stack.head;
+    if (OJC_OK != pi.err.code && 0 != err) {
+	err->code = pi.err.code;
+	memcpy(err->msg, pi.err.msg, sizeof(pi.err.msg));
+    }
+    parse_cleanup(&pi);
+
+    return val;
+}
+
+// A parser that is fed data as it arrives instead of reading it. Bytes that
+// are part of an unfinished token are kept in buf until the rest is fed.
+struct _ojcParser {
+    struct _ParseInfo	pi;
+    char		*buf;
+    size_t		size;
+    size_t		len;
+};
+
+static void
+parser_run(ojcErr err, ojcParser parser, bool last) {
+    ParseInfo	pi = &parser->pi;
+    int		line = pi->rd.line;
+    int		col = pi->rd.col;
+    size_t	pos = pi->rd.pos;
+    size_t	used;
+
+    ojc_reader_init_strn(&pi->err, &pi->rd, parser->buf, parser->len);
+    pi->rd.line = line;
+    pi->rd.col = col;
+    pi->rd.pos = pos;
+    ojc_parse_push(pi, last);
+    used = pi->rd.tail - parser->buf;
+    // An unfinished token stays where it is so each feed only looks at the
+    // new bytes.
+    if (0 < used) {
+	ojc_reader_drop(&pi->rd, used);
+	memmove(parser->buf, parser->buf + used, parser->len - used);
+	parser->len -= used;
+    }
+    if (OJC_OK != pi->err.code && 0 != err) {
+	err->code = pi->err.code;
+	memcpy(err->msg, pi->err.msg, sizeof(pi->err.msg));
+    }
+}
+
+ojcParser
+ojc_parser_create(ojcParseCallback cb, void *ctx) {
+    ojcParser	parser;
+
+    if (NULL == cb || NULL == (parser = (ojcParser)malloc(sizeof(struct _ojcParser)))) {
+	return NULL;
+    }
+    parse_init(&parser->pi.err, &parser->pi, cb, ctx);
+    parser->size = sizeof(parser->pi.rd.base);
+    parser->len = 0;
+    if (NULL == (parser->buf = (char*)malloc(parser->size))) {
+	free(parser);
+	return NULL;
+    }
+    *parser->buf = '\0';
+    ojc_reader_init_strn(&parser->pi.err, &parser->pi.rd, parser->buf, 0);
+
+    return parser;
+}
+
+void
+ojc_parser_feed(ojcErr err, ojcParser parser, const char *bytes, size_t len) {
+    if (0 != err && OJC_OK != err->code) {
+	// Previous call must have failed or err was not initialized.
+	return;
+    }
+    if (OJC_OK != parser->pi.err.code) {
+	if (0 != err) {
+	    err->code = parser->pi.err.code;
+	    memcpy(err->msg, parser->pi.err.msg, sizeof(parser->pi.err.msg));
+	}
+	return;
+    }
+    if (parser->size <= parser->len + len) {
+	size_t	size = parser->size * 2;
+	char	*buf;
+
+	while (size <= parser->len + len) {
+	    size *= 2;
+	}
+	if (NULL == (buf = (char*)realloc(parser->buf, size))) {
+	    if (0 != err) {
+		err->code = OJC_MEMORY_ERR;
+		snprintf(err->msg, sizeof(err->msg), "Failed to allocate a %lu byte parser buffer.", (unsigned long)size);
+	    }
+	    return;
+	}
+	parser->buf = buf;
+	parser->size = size;
+    }
+    memcpy(parser->buf + parser->len, bytes, len);
+    parser->len += len;
+    parser->buf[parser->len] = '\0';
+    parser_run(err, parser, false);
+}
+
+void
+ojc_parser_finish(ojcErr err, ojcParser parser) {
+    if (0 != err && OJC_OK != err->code) {
+	// Previous call must have failed or err was not initialized.
+	return;
+    }
+    if (OJC_OK != parser->pi.err.code) {
+	if (0 != err) {
+	    err->code = parser->pi.err.code;
+	    memcpy(err->msg, parser->pi.err.msg, sizeof(parser->pi.err.msg));
+	}
+	return;
+    }
+    parser_run(err, parser, true);
+}
+
+// Bytes kept for an unfinished token have not been parsed yet so they are
+// not counted.
+size_t
+ojc_parser_position(ojcParser parser, int *linep, int *colp) {
+    if (NULL != linep) {
+	*linep = parser->pi.rd.line;
+    }
+    if (NULL != colp) {
+	*colp = parser->pi.rd.col;
+    }
+    return parser->pi.rd.pos;
+}
+
+void
+ojc_parser_destroy(ojcParser parser) {
+    if (NULL != parser) {
+	// An unfinished document is dropped.
+	ojc_destroy(*parser->pi.stack.head);
+	parse_cleanup(&parser->pi);
+	free(parser->buf);
+	free(parser);
+    }
+}
+
+// Keys and strings are compared with their lengths since referenced ones are
+// not terminated.
+static bool
+key_match(ojcVal m, const char *key, int klen) {
+    const char	*mkey = _ojc_key_ptr(m);
+
+    if (NULL == mkey || klen != _ojc_key_len(m)) {
+	return false;
+    }
+    return 0 == (ojc_case_insensitive ? strncasecmp(key, mkey, klen) : memcmp(key, mkey, klen));
+}
+
+// Interned keys match only if the pointers are the same. ikey is the interned
+// copy of key or NULL if key has never been interned.
+static inline bool
+ikey_match(ojcVal m, const char *ikey, const char *key, int klen) {
+    if (STR_INTERN == _ojc_key_kind(m) && !ojc_case_insensitive) {
+	return ikey == m->key.str;
+    }
+    return key_match(m, key, klen);
+}
+
+static int
+str_cmp(const char *s1, int len1, const char *s2, int len2) {
+    int	x = ojc_case_insensitive ?
+	strncasecmp(s1, s2, len1 < len2 ? len1 : len2) :
+	memcmp(s1, s2, len1 < len2 ? len1 : len2);
+
+    // Same result as strcmp() when one is a prefix of the other.
+    if (0 == x && len1 != len2) {
+	if (len1 < len2) {
+	    x = -(int)(ojc_case_insensitive ? tolower((uint8_t)s2[len1]) : (uint8_t)s2[len1]);
+	} else {
+	    x = ojc_case_insensitive ? tolower((uint8_t)s1[len2]) : (uint8_t)s1[len2];
+	}
+    }
+    return x;
+}
+
+static int
+key_cmp(ojcVal m1, ojcVal m2) {
+    const char	*k1 = _ojc_key_ptr(m1);
+    const char	*k2 = _ojc_key_ptr(m2);
+
+    return str_cmp(NULL == k1 ? "" : k1, _ojc_key_len(m1), NULL == k2 ? "" : k2, _ojc_key_len(m2));
+}
+
 ojcVal
 ojc_get(ojcVal val, const char *path) {
     const char		*start;
@@ -272,21 +772,19 @@ ojc_get(ojcVal val, const char *path) {
 	}
     case OJC_OBJECT:
 	{
-	    const char	*key;
 	    int		plen;
+	    const char	*ikey;
 
 	    for (; '\0' != *path && '/' != *path && '.' != *path; path++) {
 	    }
 	    plen = path - start;
+	    ikey = _ojc_intern_find(start, plen);
 	    for (m = val->members.head; ; m = m->next) {
 		if (NULL == m) {
 		    return NULL;
 		}
-		if (NULL != (key = ojc_key(m))) {
-		    if ((ojc_case_insensitive ? 0 == strncasecmp(start, key, plen) : 0 == strncmp(start, key, plen)) &&
-			'\0' == key[plen]) {
-			return ojc_get(m, path);
-		    }
+		if (ikey_match(m, ikey, start, plen)) {
+		    return ojc_get(m, path);
 		}
 	    }
 	    break;
@@ -328,17 +826,14 @@ ojc_aget(ojcVal val, const char **path) {
 	}
     case OJC_OBJECT:
 	{
-	    const char	*key;
+	    int		klen = (int)strlen(*path);
+	    const char	*ikey = _ojc_intern_find(*path, klen);
 
 	    for (m = val->members.head; ; m = m->next) {
 		if (0 == m) {
 		    return 0;
 		}
-		key = ojc_key(m);
-		if (0 != key &&
-		    (ojc_case_insensitive ?
-		     0 == strcasecmp(*path, key) :
-		     0 == strcmp(*path, key))) {
+		if (ikey_match(m, ikey, *path, klen)) {
 		    return ojc_aget(m, path + 1);
 		}
 	    }
@@ -392,7 +887,6 @@ get_parent(ojcVal val, const char *path, const char **keyp) {
 	return 0;
     }
     case OJC_OBJECT: {
-	const char	*key;
 	int		plen;
 	struct _ojcErr	err = OJC_ERR_INIT;
 	ojcVal		child;
@@ -405,12 +899,7 @@ get_parent(ojcVal val, const char *path, const char **keyp) {
 	}
 	plen = path - start;
 	for (m = val->members.head; 0 != m; m = m->next) {
-	    key = ojc_key(m);
-	    if (0 != key &&
-		(ojc_case_insensitive ?
-		 0 == strncasecmp(start, key, plen) :
-		 0 == strncmp(start, key, plen)) &&
-		'\0' == key[plen]) {
+	    if (key_match(m, start, plen)) {
 		ojcVal	p = get_parent(m, path, keyp);
 
 		if (0 != p) {
@@ -466,20 +955,17 @@ get_aparent(ojcVal val, const char **path, const char **keyp) {
 	return 0;
     }
     case OJC_OBJECT: {
-	const char	*key;
 	struct _ojcErr	err = OJC_ERR_INIT;
 	ojcVal		child;
+	int		klen;
 
 	if (0 == *pn) {
 	    *keyp = *path;
 	    return val;
 	}
+	klen = (int)strlen(*path);
 	for (m = val->members.head; 0 != m; m = m->next) {
-	    key = ojc_key(m);
-	    if (0 != key &&
-		(ojc_case_insensitive ?
-		 0 == strcasecmp(*path, key) :
-		 0 == strcmp(*path, key))) {
+	    if (key_match(m, *path, klen)) {
 		ojcVal	parent = get_aparent(m, pn, keyp);
 
 		if (0 != parent) {
@@ -873,13 +1359,7 @@ ojc_number(ojcErr err, ojcVal val) {
     if (!is_type_ok(err, val, OJC_NUMBER)) {
 	return NULL;
     }
-    if ((int)sizeof(union _Bstr) <= val->str_len) {
-	return val->str.str;
-    }
-    if ((int)sizeof(val->str.ca) <= val->str_len) {
-	return val->str.bstr->ca;
-    }
-    return val->str.ca;
+    return _ojc_str_ptr(val);
 }
 
 int
@@ -887,7 +1367,7 @@ ojc_number_len(ojcErr err, ojcVal val) {
     if (!is_type_ok(err, val, OJC_NUMBER)) {
 	return 0;
     }
-    return val->str_len;
+    return _ojc_str_len(val);
 }
 
 const char*
@@ -895,13 +1375,16 @@ ojc_str(ojcErr err, ojcVal val) {
     if (!is_type_ok(err, val, OJC_STRING)) {
 	return NULL;
     }
-    if ((int)sizeof(union _Bstr) <= val->str_len) {
-	return val->str.str;
-    }
-    if ((int)sizeof(val->str.ca) <= val->str_len) {
-	return val->str.bstr->ca;
+    // Accessors do not change values so threads can share a tree. A borrowed
+    // string that is not terminated can only be read with ojc_str_ref().
+    if (!_ojc_str_terminated(val)) {
+	if (0 != err) {
+	    err->code = OJC_TYPE_ERR;
+	    snprintf(err->msg, sizeof(err->msg), "Borrowed string is not terminated, use ojc_str_ref()");
+	}
+	return NULL;
     }
-    return val->str.ca;
+    return _ojc_str_ptr(val);
 }
 
 int
@@ -909,7 +1392,19 @@ ojc_str_len(ojcErr err, ojcVal val) {
     if (!is_type_ok(err, val, OJC_STRING)) {
 	return 0;
     }
-    return val->str_len;
+    return _ojc_str_len(val);
+}
+
+// Borrowed strings are returned as is so they may not be terminated.
+const char*
+ojc_str_ref(ojcErr err, ojcVal val, int *lenp) {
+    if (!is_type_ok(err, val, OJC_STRING)) {
+	*lenp = 0;
+	return NULL;
+    }
+    *lenp = _ojc_str_len(val);
+
+    return _ojc_str_ptr(val);
 }
 
 const char*
@@ -992,29 +1487,27 @@ ojc_has_key(ojcVal val) {
 
 const char*
 ojc_key(ojcVal val) {
-    if (KEY_NONE == val->key_len) {
+    if (!_ojc_key_terminated(val)) {
 	return NULL;
     }
-    if ((int)sizeof(union _Bstr) <= val->key_len) {
-	return val->key.str;
-    }
-    if ((int)sizeof(val->key.ca) <= val->key_len) {
-	return val->key.bstr->ca;
-    }
-    return val->key.ca;
+    return _ojc_key_ptr(val);
 }
 
 int
 ojc_key_len(ojcVal val) {
-    if (KEY_NONE == val->key_len) {
-	return 0;
-    }
-    return val->key_len;
+    return _ojc_key_len(val);
+}
+
+const char*
+ojc_key_ref(ojcVal val, int *lenp) {
+    *lenp = _ojc_key_len(val);
+
+    return _ojc_key_ptr(val);
 }
 
 void
 ojc_set_key(ojcVal val, const char *key) {
-    _ojc_set_key(val, key, 0);
+    _ojc_set_key(val, key, -1);
 }
 
 
@@ -1208,21 +1701,17 @@ ojc_object_append(ojcErr err, ojcVal object, const char *key, ojcVal val) {
     ojc_object_nappend(err, object, key, strlen(key), val);
 }
 
-bool
-ojc_object_replace(ojcErr err, ojcVal object, const char *key, ojcVal val) {
+static bool
+object_nreplace(ojcErr err, ojcVal object, const char *key, int klen, ojcVal val) {
     ojcVal	m;
     ojcVal	prev = 0;
-    const char	*mkey;
     
     if (bad_object(err, object, "replace")) {
 	return false;
     }
-    _ojc_set_key(val, key, 0);
+    _ojc_set_key(val, key, klen);
     for (m = object->members.head; 0 != m; m = m->next) {
-	if (NULL == (mkey = ojc_key(m))) {
-	    continue;
-	}
-	if (ojc_case_insensitive ? 0 == strcasecmp(key, mkey) : 0 == strcmp(key, mkey)) {
+	if (key_match(m, key, klen)) {
 	    val->next = m->next;
 	    if (0 == prev) {
 		object->members.head = val;
@@ -1239,17 +1728,22 @@ ojc_object_replace(ojcErr err, ojcVal object, const char *key, ojcVal val) {
 	prev = m;
     }
     // nothing replaces so append
-    ojc_object_append(err, object, key, val);
+    ojc_object_nappend(err, object, key, klen, val);
 
     return false;
 }
 
+bool
+ojc_object_replace(ojcErr err, ojcVal object, const char *key, ojcVal val) {
+    return object_nreplace(err, object, key, (int)strlen(key), val);
+}
+
 void
 ojc_object_insert(ojcErr err, ojcVal object, int before, const char *key, ojcVal val) {
     if (bad_object(err, object, "insert")) {
 	return;
     }
-    _ojc_set_key(val, key, 0);
+    _ojc_set_key(val, key, -1);
     val->next = 0;
     if (0 >= before || 0 == object->members.head) {
 	val->next = object->members.head;
@@ -1324,15 +1818,15 @@ ojc_object_take(ojcErr err, ojcVal object, const char *key) {
     ojcVal	m;
     ojcVal	prev = 0;
     ojcVal	next;
+    int		klen;
 
     if (bad_object(err, object, "take by key")) {
 	return NULL;
     }
+    klen = (int)strlen(key);
     for (m = object->members.head; 0 != m; m = next) {
 	next = m->next;
-	if (ojc_case_insensitive ?
-	    0 == strcasecmp(key, ojc_key(m)) :
-	    0 == strcmp(key, ojc_key(m))) {
+	if (key_match(m, key, klen)) {
 	    if (0 == prev) {
 		object->members.head = m->next;
 	    } else {
@@ -1354,15 +1848,15 @@ ojc_object_remove_by_key(ojcErr err, ojcVal object, const char *key) {
     ojcVal	m;
     ojcVal	prev = 0;
     ojcVal	next;
+    int		klen;
 
     if (bad_object(err, object, "remove by key")) {
 	return false;
     }
+    klen = (int)strlen(key);
     for (m = object->members.head; 0 != m; m = next) {
 	next = m->next;
-	if (ojc_case_insensitive ?
-	    0 == strcasecmp(key, ojc_key(m)) :
-	    0 == strcmp(key, ojc_key(m))) {
+	if (key_match(m, key, klen)) {
 	    if (0 == prev) {
 		object->members.head = m->next;
 	    } else {
@@ -1380,28 +1874,34 @@ ojc_object_remove_by_key(ojcErr err, ojcVal object, const char *key) {
     return (NULL != m);
 }
 
-ojcVal
-ojc_object_get_by_key(ojcErr err, ojcVal object, const char *key) {
+static ojcVal
+object_get_by_nkey(ojcErr err, ojcVal object, const char *key, int klen) {
     ojcVal	m;
+    const char	*ikey;
 
     if (bad_object(err, object, "get by key")) {
 	return 0;
     }
+    ikey = _ojc_intern_find(key, klen);
     for (m = object->members.head; 0 != m; m = m->next) {
-	if (ojc_case_insensitive ?
-	    0 == strcasecmp(key, ojc_key(m)) :
-	    0 == strcmp(key, ojc_key(m))) {
+	if (ikey_match(m, ikey, key, klen)) {
 	    break;
 	}
     }
     return m;
 }
 
+ojcVal
+ojc_object_get_by_key(ojcErr err, ojcVal object, const char *key) {
+    return object_get_by_nkey(err, object, key, (int)strlen(key));
+}
+
 void
 ojc_merge(ojcErr err, ojcVal primary, ojcVal other) {
     ojcVal	m;
     ojcVal	pm;
     const char	*key;
+    int		klen;
 
     if (0 != err && OJC_OK != err->code) {
 	// Previous call must have failed or err was not initialized.
@@ -1415,9 +1915,10 @@ ojc_merge(ojcErr err, ojcVal primary, ojcVal other) {
     }
     if (OJC_OBJECT == ojc_type(primary)) {
 	for (m = other->members.head; NULL != m; m = m->next) {
-	    key = ojc_key(m);
-	    if (NULL == (pm = ojc_object_get_by_key(err, primary, key))) {
-		ojc_object_append(err, primary, key, ojc_duplicate(m));
+	    key = _ojc_key_ptr(m);
+	    klen = _ojc_key_len(m);
+	    if (NULL == (pm = object_get_by_nkey(err, primary, key, klen))) {
+		ojc_object_nappend(err, primary, key, klen, ojc_duplicate(m));
 	    } else if (m->type != pm->type) {
 		if ((OJC_TRUE == m->type && OJC_FALSE == pm->type) ||
 		    (OJC_FALSE == m->type && OJC_TRUE == pm->type)) {
@@ -1425,7 +1926,7 @@ ojc_merge(ojcErr err, ojcVal primary, ojcVal other) {
 		} else {
 		    if (NULL != err) {
 			err->code = OJC_TYPE_ERR;
-			snprintf(err->msg, sizeof(err->msg), "Can not merge when types do not match for %s.", key);
+			snprintf(err->msg, sizeof(err->msg), "Can not merge when types do not match for %.*s.", klen, key);
 		    }
 		    return;
 		}
@@ -1437,7 +1938,7 @@ ojc_merge(ojcErr err, ojcVal primary, ojcVal other) {
 		case OJC_DECIMAL:
 		case OJC_WORD:
 		case OJC_OPAQUE:
-		    ojc_object_replace(err, primary, key, ojc_duplicate(m));
+		    object_nreplace(err, primary, key, klen, ojc_duplicate(m));
 		    break;
 		case OJC_OBJECT:
 		    ojc_merge(err, pm, m);
@@ -1658,15 +2159,17 @@ ojc_array_insert(ojcErr err, ojcVal array, int pos, ojcVal val) {
 }
 
 static void
-fixnum_fill(Buf bb, int64_t num) {
+fixnum_fill(Buf bb, int64_t n) {
     char	buf[32];
     char	*end = buf + sizeof(buf) - 1;
     char	*b = end;
     int		neg = 0;
+    uint64_t	num = (uint64_t)n;
 
-    if (0 > num) {
+    // Unsigned so the most negative fixnum can be negated.
+    if (0 > n) {
 	neg = 1;
-	num = -num;
+	num = 0 - num;
     }
     *b-- = '\0';
     if (0 < num) {
@@ -1855,6 +2358,7 @@ fill_buf(Buf buf, ojcVal val, int indent, int depth) {
 	    size_t	icnt = indent * d2;
 	    char	in[256];
 	    const char	*key;
+	    const char	*end;
 
 	    if (0 < indent) {
 		if (sizeof(in) <= icnt - 2) {
@@ -1874,17 +2378,12 @@ fill_buf(Buf buf, ojcVal val, int indent, int depth) {
 		    buf_append_string(buf, in, icnt);
 		}
 		buf_append(buf, '"');
-		if (KEY_NONE == m->key_len) {
-		    key = "";
-		} else if ((int)sizeof(union _Bstr) <= m->key_len) {
-		    key = m->key.str;
-		} else if ((int)sizeof(m->key.ca) <= m->key_len) {
-		    key = m->key.bstr->ca;
-		} else {
-		    key = m->key.ca;
-		}
-		while ('\0' != *key) {
-		    key = buf_append_chars(buf, key);
+		if (NULL != (key = _ojc_key_ptr(m))) {
+		    // Borrowed keys are not terminated so stop at the length.
+		    end = key + _ojc_key_len(m);
+		    while (key < end && OJC_OK == buf->err) {
+			key = buf_append_chars(buf, key);
+		    }
 		}
 		buf_append(buf, '"');
 		buf_append(buf, ':');
@@ -1910,17 +2409,11 @@ fill_buf(Buf buf, ojcVal val, int indent, int depth) {
 	break;
     case OJC_STRING:
 	{
-	    const char	*str;
+	    const char	*str = _ojc_str_ptr(val);
+	    const char	*end = str + _ojc_str_len(val);
 
 	    buf_append(buf, '"');
-	    if ((int)sizeof(union _Bstr) <= val->str_len) {
-		str = val->str.str;
-	    } else if ((int)sizeof(val->str.ca) <= val->str_len) {
-		str = val->str.bstr->ca;
-	    } else {
-		str = val->str.ca;
-	    }
-	    while ('\0' != *str) {
+	    while (str < end && OJC_OK == buf->err) {
 		str = buf_append_chars(buf, str);
 	    }
 	    buf_append(buf, '"');
@@ -1947,18 +2440,7 @@ fill_buf(Buf buf, ojcVal val, int indent, int depth) {
 	}
 	break;
     case OJC_NUMBER:
-	{
-	    const char	*str;
-
-	    if ((int)sizeof(union _Bstr) <= val->str_len) {
-		str = val->str.str;
-	    } else if ((int)sizeof(val->str.ca) <= val->str_len) {
-		str = val->str.bstr->ca;
-	    } else {
-		str = val->str.ca;
-	    }
-	    buf_append_string(buf, str, val->str_len);
-	}
+	buf_append_string(buf, _ojc_str_ptr(val), _ojc_str_len(val));
 	break;
     case OJC_OPAQUE:
 	if (ojc_write_opaque) {
@@ -2071,16 +2553,10 @@ ojc_duplicate(ojcVal val) {
 	    const char	*key;
 
 	    for (m = val->members.head; 0 != m; m = m->next) {
-		if (KEY_NONE == m->key_len) {
+		if (NULL == (key = _ojc_key_ptr(m))) {
 		    key = "";
-		} else if ((int)sizeof(union _Bstr) <= m->key_len) {
-		    key = m->key.str;
-		} else if ((int)sizeof(m->key.ca) <= m->key_len) {
-		    key = m->key.bstr->ca;
-		} else {
-		    key = m->key.ca;
 		}
-		ojc_object_append(&err, dup, key, ojc_duplicate(m));
+		ojc_object_nappend(&err, dup, key, _ojc_key_len(m), ojc_duplicate(m));
 	    }
 	}
 	break;
@@ -2090,14 +2566,22 @@ ojc_duplicate(ojcVal val) {
 	break;
     case OJC_STRING:
     case OJC_NUMBER:
-	dup->str_len = val->str_len;
-	if ((int)sizeof(union _Bstr) <= val->str_len) {
-	    dup->str.str = strdup(val->str.str);
-	} else if ((int)sizeof(val->str.ca) <= val->str_len) {
-	    dup->str.bstr = _ojc_bstr_create();
-	    strcpy(dup->str.bstr->ca, val->str.bstr->ca);
-	} else {
-	    strcpy(dup->str.ca, val->str.ca);
+	{
+	    // A borrowed string becomes an owned copy.
+	    const char	*str = _ojc_str_ptr(val);
+	    int		len = _ojc_str_len(val);
+
+	    dup->str_len = len;
+	    if ((int)sizeof(union _Bstr) <= len) {
+		dup->str.str = strndup(str, len);
+	    } else if ((int)sizeof(dup->str.ca) <= len) {
+		dup->str.bstr = _ojc_bstr_create();
+		memcpy(dup->str.bstr->ca, str, len);
+		dup->str.bstr->ca[len] = '\0';
+	    } else {
+		memcpy(dup->str.ca, str, len);
+		dup->str.ca[len] = '\0';
+	    }
 	}
 	break;
     case OJC_WORD:
@@ -2126,30 +2610,11 @@ ojc_equals(ojcVal v1, ojcVal v2) {
 	return false;
     }
     switch (ojc_type(v1)) {
-    case OJC_STRING: {
-	const char	*s1 = ojc_str(&err, v1);
-	const char	*s2 = ojc_str(&err, v2);
-
-	if (NULL == s1) {
-	    s1 = "";
-	}
-	if (NULL == s2) {
-	    s2 = "";
-	}
-	return 0 == (ojc_case_insensitive ? strcasecmp(s1, s2) : strcmp(s1, s2));
-    }
-    case OJC_NUMBER: {
-	const char	*s1 = ojc_number(&err, v1);
-	const char	*s2 = ojc_number(&err, v2);
-
-	if (NULL == s1) {
-	    s1 = "";
-	}
-	if (NULL == s2) {
-	    s2 = "";
-	}
-	return 0 == strcmp(s1, s2);
-    }
+    case OJC_STRING:
+	return 0 == str_cmp(_ojc_str_ptr(v1), _ojc_str_len(v1), _ojc_str_ptr(v2), _ojc_str_len(v2));
+    case OJC_NUMBER:
+	return _ojc_str_len(v1) == _ojc_str_len(v2) &&
+	    0 == memcmp(_ojc_str_ptr(v1), _ojc_str_ptr(v2), _ojc_str_len(v1));
     case OJC_FIXNUM:
 	return ojc_int(&err, v1) == ojc_int(&err, v2);
     case OJC_DECIMAL:
@@ -2173,10 +2638,7 @@ ojc_equals(ojcVal v1, ojcVal v2) {
 	ojcVal	m2 = ojc_members(&err, v2);
 
 	for (; 0 != m1 && 0 != m2; m1 = m1->next, m2 = m2->next) {
-	    if ((0 != (ojc_case_insensitive ?
-		       strcasecmp(ojc_key(m1), ojc_key(m2)) :
-		       strcmp(ojc_key(m1), ojc_key(m2)))) ||
-		!ojc_equals(m1, m2)) {
+	    if (0 != key_cmp(m1, m2) || !ojc_equals(m1, m2)) {
 		return false;
 	    }
 	}
@@ -2214,26 +2676,18 @@ ojc_cmp(ojcVal v1, ojcVal v2) {
 
     switch (ojc_type(v1)) {
     case OJC_STRING: {
-	const char	*s1 = ojc_str(&err, v1);
 	const char	*s2 = NULL;
 
 	switch (ojc_type(v2)) {
 	case OJC_STRING:
-	    s2 = ojc_str(&err, v2);
-	    break;
+	    return str_cmp(_ojc_str_ptr(v1), _ojc_str_len(v1), _ojc_str_ptr(v2), _ojc_str_len(v2));
 	case OJC_WORD:
 	    s2 = ojc_word(&err, v2);
 	    break;
 	default:
 	    return (int)ojc_type(v1) - (int)ojc_type(v2);
 	}
-	if (NULL == s1) {
-	    s1 = "";
-	}
-	if (NULL == s2) {
-	    s2 = "";
-	}
-	return (ojc_case_insensitive ? strcasecmp(s1, s2) : strcmp(s1, s2));
+	return str_cmp(_ojc_str_ptr(v1), _ojc_str_len(v1), s2, (int)strlen(s2));
     }
     case OJC_NUMBER: {
 	// TBD convert to int or double
@@ -2327,10 +2781,7 @@ ojc_cmp(ojcVal v1, ojcVal v2) {
 	int	x;
 
 	for (; 0 != m1 && 0 != m2; m1 = m1->next, m2 = m2->next) {
-	    if (0 != (x = (ojc_case_insensitive ?
-			   strcasecmp(ojc_key(m1), ojc_key(m2)) :
-			   strcmp(ojc_key(m1), ojc_key(m2)))) ||
-		0 != (x = ojc_cmp(m1, m2))) {
+	    if (0 != (x = key_cmp(m1, m2)) || 0 != (x = ojc_cmp(m1, m2))) {
 		return x;
 	    }
 	}
@@ -2346,19 +2797,18 @@ ojc_cmp(ojcVal v1, ojcVal v2) {
 	const char	*s1 = ojc_word(&err, v1);
 	const char	*s2 = NULL;
 
+	if (NULL == s1) {
+	    s1 = "";
+	}
 	switch (ojc_type(v2)) {
 	case OJC_STRING:
-	    s2 = ojc_str(&err, v2);
-	    break;
+	    return str_cmp(s1, (int)strlen(s1), _ojc_str_ptr(v2), _ojc_str_len(v2));
 	case OJC_WORD:
 	    s2 = ojc_word(&err, v2);
 	    break;
 	default:
 	    return (int)ojc_type(v1) - (int)ojc_type(v2);
 	}
-	if (NULL == s1) {
-	    s1 = "";
-	}
 	if (NULL == s2) {
 	    s2 = "";
 	}
@@ -47,23 +47,50 @@ extern "C" {
  */
 #define OJC_VERSION	"3.1.1"
 #define OJC_ERR_INIT	{ 0, { 0 } }
+// Flag for ojc_parse_file_parallel() to call the callback as soon as each
+// value is parsed instead of in file order.
+#define OJC_UNORDERED	0x01
 
     extern bool		ojc_newline_ok;
+    extern bool		ojc_parse_newline_ok;
     extern bool		ojc_word_ok;
     extern bool		ojc_decimal_as_number;
     extern bool		ojc_case_insensitive;
     extern bool		ojc_write_opaque;
     extern bool		ojc_write_end_with_newline;
+    extern bool		ojc_intern_keys;
+    extern size_t	ojc_read_buf_size;
+    extern size_t	ojc_read_buf_max;
+    extern bool		ojc_read_huge_pages;
+    extern bool		ojc_read_ring;
+    extern bool		ojc_io_uring;
+    extern bool		ojc_read_ahead;
+    extern size_t	ojc_parse_threads;
+    extern size_t	ojc_reclaim_threads;
+    extern size_t	ojc_callback_threads;
+    extern size_t	ojc_callback_queue;
 
     extern const char*	ojc_version(void);
     extern void		ojc_cleanup(void);
     extern ojcVal	ojc_parse_str(ojcErr err, const char *json, ojcParseCallback cb, void *ctx);
     extern ojcVal	ojc_parse_strp(ojcErr err, const char **jsonp);
+    extern ojcVal	ojc_parse_borrow(ojcErr err, const char *json, ojcParseCallback cb, void *ctx);
+    extern ojcVal	ojc_parse_insitu(ojcErr err, char *buf, size_t len, ojcParseCallback cb, void *ctx);
     extern ojcVal	ojc_parse_file(ojcErr err, FILE *file, ojcParseCallback cb, void *ctx);
+    extern ojcVal	ojc_parse_path(ojcErr err, const char *path, ojcParseCallback cb, void *ctx);
+    extern void		ojc_parse_file_parallel(ojcErr err, const char *path, int nthreads, ojcParseCallback cb, void *ctx, int flags);
     extern ojcVal	ojc_parse_fd(ojcErr err, int socket, ojcParseCallback cb, void *ctx);
     extern void		ojc_parse_file_follow(ojcErr err, FILE *file, ojcParseCallback cb, void *ctx);
     extern ojcVal	ojc_parse_reader(ojcErr err, void *src, ojcReadFunc rf, ojcParseCallback cb, void *ctx);
+    extern ojcVal	ojc_parse_lender(ojcErr err, void *src, ojcLendFunc lend, ojcReleaseFunc release, ojcParseCallback cb, void *ctx);
+
+    extern ojcParser	ojc_parser_create(ojcParseCallback cb, void *ctx);
+    extern void		ojc_parser_feed(ojcErr err, ojcParser parser, const char *bytes, size_t len);
+    extern void		ojc_parser_finish(ojcErr err, ojcParser parser);
+    extern size_t	ojc_parser_position(ojcParser parser, int *linep, int *colp);
+    extern void		ojc_parser_destroy(ojcParser parser);
     extern int		ojc_destroy(ojcVal val);
+    extern int		ojc_destroy_async(ojcVal val);
     extern ojcVal	ojc_get(ojcVal val, const char *path);
     extern ojcVal	ojc_aget(ojcVal val, const char **path);
     extern void		ojc_append(ojcErr err, ojcVal anchor, const char *path, ojcVal val);
@@ -82,6 +109,7 @@ extern "C" {
     extern int		ojc_number_len(ojcErr err, ojcVal val);
     extern const char*	ojc_str(ojcErr err, ojcVal val);
     extern int		ojc_str_len(ojcErr err, ojcVal val);
+    extern const char*	ojc_str_ref(ojcErr err, ojcVal val, int *lenp);
     extern const char*	ojc_word(ojcErr err, ojcVal val);
     extern void*	ojc_opaque(ojcErr err, ojcVal val);
     extern ojcVal	ojc_members(ojcErr err, ojcVal val);
@@ -90,6 +118,7 @@ extern "C" {
     extern bool		ojc_has_key(ojcVal val);
     extern const char*	ojc_key(ojcVal val);
     extern int		ojc_key_len(ojcVal val);
+    extern const char*	ojc_key_ref(ojcVal val, int *lenp);
     extern void		ojc_set_key(ojcVal val, const char *key);
     extern ojcVal	ojc_create_object(void);
     extern ojcVal	ojc_create_array(void);
@@ -0,0 +1,682 @@
+/* parallel.c
+ * Copyright (c) 2014, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "parallel.h"
+#include "parse.h"
+#include "simd.h"
+
+// A chunk being parsed or waiting to be passed to the callback in order.
+typedef struct _Chunk {
+    ojcVal		head;	// parsed values linked by next
+    ojcVal		tail;
+    bool		done;
+    struct _ojcErr	err;
+} *Chunk;
+
+typedef struct _Par {
+    pthread_mutex_t	lock;
+    pthread_cond_t	cond;
+    const char		*json;
+    const char		*end;
+    const char		*next;		// start of the next chunk
+    size_t		target;
+    ojcParseCallback	cb;
+    void		*ctx;
+    bool		ordered;
+    bool		delivering;	// a thread is calling cb in order
+    bool		stop;
+    size_t		claimed;	// chunks handed to threads
+    size_t		delivered;	// chunks passed to cb in order
+    Chunk		slots;		// reorder buffer indexed by chunk % slot_cnt
+    size_t		slot_cnt;
+    struct _ojcErr	err;
+    size_t		err_index;
+} *Par;
+
+// A position in the JSON with its line and column so line counting can pick
+// up from there instead of starting over.
+typedef struct _Mark {
+    const char	*json;
+    const char	*ptr;
+    int		line;
+    int		col;
+} *Mark;
+
+static bool
+collect_cb(ojcErr err, ojcVal val, void *ctx) {
+    Chunk	c = (Chunk)ctx;
+
+    val->next = NULL;
+    if (NULL == c->head) {
+	c->head = val;
+    } else {
+	c->tail->next = val;
+    }
+    c->tail = val;
+
+    return false;
+}
+
+static bool
+discard_cb(ojcErr err, ojcVal val, void *ctx) {
+    return true;
+}
+
+static void
+destroy_list(ojcVal val) {
+    ojcVal	next;
+
+    for (; NULL != val; val = next) {
+	next = val->next;
+	val->next = NULL;
+	ojc_destroy(val);
+    }
+}
+
+// Frees the value left partly built by an error along with any key.
+static void
+drop_partial(ParseInfo pi) {
+    ojcVal	val = stack_head(&pi->stack);
+
+    if (NULL != val) {
+	ojc_parse_val_destroy(pi, val);
+    }
+    pi->stack.tail = pi->stack.head;
+    *pi->stack.head = NULL;
+    if (pi->kalloc) {
+	free(pi->key);
+    }
+    pi->key = NULL;
+    pi->klen = 0;
+    pi->kalloc = false;
+    pi->kslot = NULL;
+}
+
+// Called with the lock held. Keeps the error from the earliest chunk.
+static void
+set_error(Par par, ojcErr err, size_t index) {
+    if (OJC_OK == par->err.code || index < par->err_index) {
+	par->err = *err;
+	par->err_index = index;
+    }
+    par->stop = true;
+    pthread_cond_broadcast(&par->cond);
+}
+
+// Starts the reader at start with the line and column counted on from the
+// mark so errors report where they are in the whole document. The mark is
+// moved up to start.
+static void
+reader_at(ParseInfo pi, Mark mark, const char *start, const char *end) {
+    ojc_reader_init_strn(&pi->err, &pi->rd, mark->ptr, end - mark->ptr);
+    pi->rd.line = mark->line;
+    pi->rd.col = mark->col;
+    pi->rd.pos = mark->ptr - mark->json;
+    ojc_reader_drop(&pi->rd, start - mark->ptr);
+    pi->rd.head = (char*)start;
+    pi->rd.tail = pi->rd.head;
+    mark->ptr = start;
+    mark->line = pi->rd.line;
+    mark->col = pi->rd.col;
+}
+
+static const char*
+chunk_end(Par par, const char *start) {
+    const char	*nl;
+
+    if ((size_t)(par->end - start) <= par->target ||
+	NULL == (nl = memchr(start + par->target, '\n', par->end - start - par->target))) {
+	return par->end;
+    }
+    return nl + 1;
+}
+
+// Parses one chunk. A chunk starts a line so on an error the chunk is parsed
+// again starting from the line and position of the chunk in the whole JSON
+// to get the same message as a single threaded parse. An error set by the
+// callback is kept as is.
+static void
+parse_chunk(Par par, ParseInfo pi, const char *start, const char *end, Chunk c) {
+    struct _Mark	mark = { par->json, par->json, 1, 0 };
+    struct _ojcErr	first;
+
+    if (NULL == c) {
+	pi->each_cb = par->cb;
+	pi->each_ctx = par->ctx;
+    } else {
+	pi->each_cb = collect_cb;
+	pi->each_ctx = c;
+    }
+    ojc_reader_init_strn(&pi->err, &pi->rd, start, end - start);
+    ojc_parse_indexed(pi);
+    if (OJC_OK == pi->err.code) {
+	return;
+    }
+    first = pi->err;
+    drop_partial(pi);
+    pi->each_cb = discard_cb;
+    reader_at(pi, &mark, start, end);
+    ojc_parse_indexed(pi);
+    drop_partial(pi);
+    if (OJC_OK == pi->err.code) {
+	pi->err = first;
+    }
+}
+
+// Called with the lock held after a chunk is done. Passes the values of
+// finished chunks to the callback in order unless another thread already is.
+// The lock is released while the callback is called so other threads can
+// keep going.
+static void
+deliver(Par par, ParseInfo pi) {
+    struct _ojcErr	cerr;
+    struct _ojcErr	perr;
+    Chunk		c;
+    ojcVal		val;
+    ojcVal		next;
+
+    if (par->delivering) {
+	return;
+    }
+    par->delivering = true;
+    while (!par->stop && par->delivered < par->claimed) {
+	c = par->slots + par->delivered % par->slot_cnt;
+	if (!c->done) {
+	    break;
+	}
+	val = c->head;
+	perr = c->err;
+	c->head = NULL;
+	c->tail = NULL;
+	par->delivered++;
+	pthread_cond_broadcast(&par->cond);
+	pthread_mutex_unlock(&par->lock);
+
+	ojc_err_init(&cerr);
+	for (; NULL != val; val = next) {
+	    next = val->next;
+	    val->next = NULL;
+	    if (OJC_OK != cerr.code) {
+		ojc_parse_val_destroy(pi, val);
+	    } else if (par->cb(&cerr, val, par->ctx)) {
+		ojc_parse_val_destroy(pi, val);
+	    }
+	}
+	pthread_mutex_lock(&par->lock);
+	if (OJC_OK != cerr.code) {
+	    set_error(par, &cerr, par->delivered - 1);
+	} else if (OJC_OK != perr.code) {
+	    set_error(par, &perr, par->delivered - 1);
+	}
+    }
+    par->delivering = false;
+}
+
+static void*
+work(void *arg) {
+    Par			par = (Par)arg;
+    struct _ParseInfo	pi;
+    const char		*start;
+    const char		*end;
+    size_t		index;
+    Chunk		c = NULL;
+
+    // One ParseInfo for all the chunks a thread parses so the free lists and
+    // predicted keys carry over. The reader starts out empty in case there
+    // are no chunks left for this thread.
+    parse_init(&pi.err, &pi, NULL, NULL);
+    ojc_reader_init_strn(&pi.err, &pi.rd, par->json, 0);
+    pthread_mutex_lock(&par->lock);
+    while (!par->stop && par->next < par->end) {
+	if (par->ordered && par->delivered + par->slot_cnt <= par->claimed) {
+	    pthread_cond_wait(&par->cond, &par->lock);
+	    continue;
+	}
+	index = par->claimed++;
+	start = par->next;
+	end = chunk_end(par, start);
+	par->next = end;
+	if (par->ordered) {
+	    c = par->slots + index % par->slot_cnt;
+	    c->head = NULL;
+	    c->tail = NULL;
+	    c->done = false;
+	    ojc_err_init(&c->err);
+	}
+	pthread_mutex_unlock(&par->lock);
+
+	parse_chunk(par, &pi, start, end, c);
+
+	pthread_mutex_lock(&par->lock);
+	if (par->ordered) {
+	    c->err = pi.err;
+	    c->done = true;
+	    deliver(par, &pi);
+	} else if (OJC_OK != pi.err.code) {
+	    set_error(par, &pi.err, index);
+	}
+    }
+    pthread_mutex_unlock(&par->lock);
+    parse_cleanup(&pi);
+
+    return NULL;
+}
+
+void
+_ojc_parse_parallel(ojcErr err, const char *json, size_t len, int thread_cnt, ojcParseCallback cb, void *ctx, bool ordered) {
+    struct _Par		par;
+    pthread_t		*threads;
+    int			cnt = 0;
+    int			i;
+
+    if (0 >= thread_cnt && 0 >= (thread_cnt = (int)sysconf(_SC_NPROCESSORS_ONLN))) {
+	thread_cnt = 1;
+    }
+    memset(&par, 0, sizeof(par));
+    par.json = json;
+    par.end = json + len;
+    par.next = json;
+    par.target = len / ((size_t)thread_cnt * PAR_SLOTS);
+    if (par.target < PAR_CHUNK_MIN) {
+	par.target = PAR_CHUNK_MIN;
+    } else if (PAR_CHUNK_MAX < par.target) {
+	par.target = PAR_CHUNK_MAX;
+    }
+    par.cb = cb;
+    par.ctx = ctx;
+    par.ordered = ordered;
+    ojc_err_init(&par.err);
+    if (ordered) {
+	par.slot_cnt = (size_t)thread_cnt * PAR_SLOTS;
+	if (NULL == (par.slots = (Chunk)calloc(par.slot_cnt, sizeof(struct _Chunk)))) {
+	    err->code = OJC_MEMORY_ERR;
+	    snprintf(err->msg, sizeof(err->msg), "Failed to allocate the parallel parse reorder buffer.");
+	    return;
+	}
+    }
+    if (NULL == (threads = (pthread_t*)malloc(sizeof(pthread_t) * thread_cnt))) {
+	free(par.slots);
+	err->code = OJC_MEMORY_ERR;
+	snprintf(err->msg, sizeof(err->msg), "Failed to allocate parallel parse threads.");
+	return;
+    }
+    pthread_mutex_init(&par.lock, NULL);
+    pthread_cond_init(&par.cond, NULL);
+    // The calling thread parses too. If a thread can not be started the
+    // others do its share.
+    for (i = 1; i < thread_cnt; i++) {
+	if (0 == pthread_create(threads + cnt, NULL, work, &par)) {
+	    cnt++;
+	}
+    }
+    work(&par);
+    for (i = 0; i < cnt; i++) {
+	pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    pthread_cond_destroy(&par.cond);
+    pthread_mutex_destroy(&par.lock);
+
+    if (NULL != par.slots) {
+	// Chunks parsed after an error are never delivered.
+	for (i = 0; i < (int)par.slot_cnt; i++) {
+	    destroy_list(par.slots[i].head);
+	}
+	free(par.slots);
+    }
+    if (OJC_OK != par.err.code) {
+	*err = par.err;
+    }
+}
+
+// A piece of a top level array. Every segment but the last ends with the
+// comma after its last element. Segments after the first are parsed into an
+// array put on the stack as if its opening bracket had been read.
+typedef struct _Seg {
+    const char	*start;
+    const char	*end;
+    ojcVal	array;	// elements or NULL if the parse did not stop cleanly
+    const char	*rest;	// where the parse of the last segment stopped
+} *Seg;
+
+typedef struct _Split {
+    const char		*json;
+    const char		*end;
+    Seg			segs;
+    size_t		cnt;
+    atomic_size_t	next;	// next segment to parse
+    ojcParseCallback	cb;
+    void		*ctx;
+    ojcVal		root;	// joined array when there is no callback
+    struct _ojcErr	err;
+} *Split;
+
+static bool
+escaped(const char *json, const char *q) {
+    const char	*b = q;
+
+    while (json < b && '\\' == *(b - 1)) {
+	b--;
+    }
+    return 1 == (q - b) % 2;
+}
+
+// Guesses where an element of the top level array starts at or after p
+// without knowing if p is in a string or how deep it is. A quote followed by
+// a colon closes a key so the scan starts after one. Then the first comma at
+// the shallowest depth seen in the window is taken on the assumption that the
+// window covers the end of at least one element. The guess is checked when
+// the segment before it is parsed.
+static const char*
+guess_split(const char *json, const char *p, const char *end) {
+    const char	*w = (SPLIT_WINDOW < (size_t)(end - p)) ? p + SPLIT_WINDOW : end;
+    const char	*s;
+    const char	*guess = NULL;
+    int		depth = 0;
+    int		min = 0;
+
+    for (s = p; s < w; s++) {
+	if ('"' == *s && !escaped(json, s)) {
+	    const char	*c = simd_skip_white(s + 1, w);
+
+	    if (c < w && ':' == *c) {
+		p = c + 1;
+		break;
+	    }
+	}
+    }
+    for (s = p; s < w; s++) {
+	switch (*s) {
+	case '"':
+	    for (s++; s < w && ('"' != *s || escaped(json, s)); s++) {
+	    }
+	    break;
+	case '{':
+	case '[':
+	    depth++;
+	    break;
+	case '}':
+	case ']':
+	    depth--;
+	    if (depth < min) {
+		min = depth;
+		guess = NULL;
+	    }
+	    break;
+	case ',':
+	    if (depth == min && NULL == guess) {
+		guess = s + 1;
+	    }
+	    break;
+	default:
+	    break;
+	}
+    }
+    return guess;
+}
+
+// Parses [start, end) as elements of the top level array. Returns the array
+// holding them if the parse stopped between elements or, for the last
+// segment, after the array close. Otherwise the partial result is dropped
+// and NULL returned with any error in pi. If mark is NULL line counting
+// starts over at start since the error will not be reported.
+static ojcVal
+parse_seg(ParseInfo pi, Mark mark, const char *start, const char *end, bool first, bool last, const char **restp) {
+    ojcVal	array;
+
+    pi->each_cb = NULL;
+    pi->partial = !last;
+    if (NULL == mark) {
+	ojc_reader_init_strn(&pi->err, &pi->rd, start, end - start);
+    } else {
+	reader_at(pi, mark, start, end);
+    }
+    if (!first) {
+	array = ojc_create_array();
+	stack_push(&pi->stack, array);
+	array->expect = NEXT_ARRAY_ELEMENT;
+    }
+    ojc_parse_indexed(pi);
+    array = stack_head(&pi->stack);
+    if (OJC_OK == pi->err.code && NULL != array &&
+	(last ? stack_empty(&pi->stack) : (1 == stack_size(&pi->stack) && NEXT_ARRAY_ELEMENT == array->expect))) {
+	pi->stack.tail = pi->stack.head;
+	*pi->stack.head = NULL;
+	*restp = pi->rd.tail;
+	return array;
+    }
+    drop_partial(pi);
+
+    return NULL;
+}
+
+static void*
+split_work(void *arg) {
+    Split		sp = (Split)arg;
+    struct _ParseInfo	pi;
+    Seg			seg;
+    size_t		i;
+
+    parse_init(&pi.err, &pi, NULL, NULL);
+    ojc_reader_init_strn(&pi.err, &pi.rd, sp->json, 0);
+    while ((i = atomic_fetch_add(&sp->next, 1)) < sp->cnt) {
+	seg = sp->segs + i;
+	seg->array = parse_seg(&pi, NULL, seg->start, seg->end, 0 == i, sp->cnt - 1 == i, &seg->rest);
+    }
+    parse_cleanup(&pi);
+
+    return NULL;
+}
+
+// Adds the elements of a segment to the joined array or passes them to the
+// callback in order.
+static void
+take(Split sp, ParseInfo pi, ojcVal array) {
+    ojcVal	val;
+    ojcVal	next;
+
+    if (NULL == sp->cb) {
+	if (NULL == sp->root) {
+	    sp->root = array;
+	    return;
+	}
+	if (NULL != array->members.head) {
+	    if (NULL == sp->root->members.head) {
+		sp->root->members.head = array->members.head;
+	    } else {
+		sp->root->members.tail->next = array->members.head;
+	    }
+	    sp->root->members.tail = array->members.tail;
+	}
+    } else {
+	for (val = array->members.head; NULL != val; val = next) {
+	    next = val->next;
+	    val->next = NULL;
+	    if (OJC_OK != sp->err.code || sp->cb(&sp->err, val, sp->ctx)) {
+		ojc_parse_val_destroy(pi, val);
+	    }
+	}
+    }
+    array->members.head = NULL;
+    array->members.tail = NULL;
+    ojc_parse_val_destroy(pi, array);
+}
+
+static void
+drop_segs(Split sp, ParseInfo pi, size_t from, size_t to) {
+    for (; from <= to && from < sp->cnt; from++) {
+	if (NULL != sp->segs[from].array) {
+	    ojc_parse_val_destroy(pi, sp->segs[from].array);
+	    sp->segs[from].array = NULL;
+	}
+    }
+}
+
+// Checks the guesses in order. A segment that starts where it should but does
+// not end cleanly means the guess for the next segment was wrong so the two
+// are parsed again as one. If that fails too the rest of the array is parsed
+// in one go which also finds any real error.
+static void
+split_join(Split sp, ParseInfo pi) {
+    struct _Mark	mark = { sp->json, sp->json, 1, 0 };
+    ojcVal		array;
+    const char		*rest = NULL;
+    Seg			seg;
+    size_t		last = sp->cnt - 1;
+    size_t		i;
+    size_t		j;
+
+    for (i = 0; i <= last && OJC_OK == sp->err.code; i = j + 1) {
+	seg = sp->segs + i;
+	j = i;
+	array = seg->array;
+	rest = seg->rest;
+	seg->array = NULL;
+	if (NULL == array) {
+	    if (i < last) {
+		j = i + 1;
+		drop_segs(sp, pi, j, j);
+		array = parse_seg(pi, &mark, seg->start, sp->segs[j].end, 0 == i, last == j, &rest);
+	    }
+	    if (NULL == array && (j < last || i == last)) {
+		drop_segs(sp, pi, j + 1, last);
+		j = last;
+		array = parse_seg(pi, &mark, seg->start, sp->end, 0 == i, true, &rest);
+	    }
+	    if (NULL == array) {
+		sp->err = pi->err;
+		break;
+	    }
+	}
+	take(sp, pi, array);
+    }
+    drop_segs(sp, pi, i, last);
+    // Anything after the array is parsed as more documents when there is a
+    // callback as it would be without splitting.
+    if (OJC_OK == sp->err.code && NULL != sp->cb && NULL != rest) {
+	rest = simd_skip_white(rest, sp->end);
+	if (rest < sp->end) {
+	    pi->each_cb = sp->cb;
+	    pi->each_ctx = sp->ctx;
+	    pi->partial = false;
+	    reader_at(pi, &mark, rest, sp->end);
+	    ojc_parse_indexed(pi);
+	    if (OJC_OK != pi->err.code) {
+		sp->err = pi->err;
+		drop_partial(pi);
+	    }
+	}
+    }
+}
+
+bool
+_ojc_parse_split(ojcErr err, const char *json, size_t len, int thread_cnt, ojcParseCallback cb, void *ctx, ojcVal *valp) {
+    struct _Split	sp;
+    struct _ParseInfo	pi;
+    pthread_t		*threads;
+    const char		*start;
+    const char		*guess;
+    size_t		size;
+    size_t		max;
+    int			cnt = 0;
+    int			i;
+
+    if (0 >= thread_cnt && 0 >= (thread_cnt = (int)sysconf(_SC_NPROCESSORS_ONLN))) {
+	thread_cnt = 1;
+    }
+    max = (size_t)thread_cnt * PAR_SLOTS;
+    if (len / max < PAR_CHUNK_MIN) {
+	max = len / PAR_CHUNK_MIN;
+    }
+    start = simd_skip_white(json, json + len);
+    if (thread_cnt < 2 || max < 2 || start >= json + len || '[' != *start) {
+	return false;
+    }
+    size = len / max;
+    memset(&sp, 0, sizeof(sp));
+    sp.json = json;
+    sp.end = json + len;
+    if (NULL == (sp.segs = (Seg)calloc(max, sizeof(struct _Seg)))) {
+	return false;
+    }
+    for (start = json; sp.cnt < max - 1; start = guess) {
+	if (sp.end <= json + size * (sp.cnt + 1) ||
+	    NULL == (guess = guess_split(json, json + size * (sp.cnt + 1), sp.end)) || guess <= start) {
+	    break;
+	}
+	sp.segs[sp.cnt].start = start;
+	sp.segs[sp.cnt].end = guess;
+	sp.cnt++;
+    }
+    if (0 == sp.cnt || NULL == (threads = (pthread_t*)malloc(sizeof(pthread_t) * thread_cnt))) {
+	free(sp.segs);
+	return false;
+    }
+    sp.segs[sp.cnt].start = start;
+    sp.segs[sp.cnt].end = sp.end;
+    sp.cnt++;
+    atomic_init(&sp.next, 0);
+    sp.cb = cb;
+    sp.ctx = ctx;
+    ojc_err_init(&sp.err);
+
+    for (i = 1; i < thread_cnt; i++) {
+	if (0 == pthread_create(threads + cnt, NULL, split_work, &sp)) {
+	    cnt++;
+	}
+    }
+    split_work(&sp);
+    for (i = 0; i < cnt; i++) {
+	pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    parse_init(&pi.err, &pi, NULL, NULL);
+    ojc_reader_init_strn(&pi.err, &pi.rd, json, 0);
+    split_join(&sp, &pi);
+    if (OJC_OK != sp.err.code) {
+	if (NULL != sp.root) {
+	    ojc_parse_val_destroy(&pi, sp.root);
+	    sp.root = NULL;
+	}
+	*err = sp.err;
+    }
+    parse_cleanup(&pi);
+    free(sp.segs);
+    *valp = sp.root;
+
+    return true;
+}
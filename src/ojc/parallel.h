@@ -0,0 +1,64 @@
+/* parallel.h
+ * Copyright (c) 2014, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __OJC_PARALLEL_H__
+#define __OJC_PARALLEL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ojc.h"
+
+// Chunks are about the length of the JSON divided by PAR_SLOTS times the
+// thread count but no smaller than PAR_CHUNK_MIN or larger than
+// PAR_CHUNK_MAX. They end after the first newline past that length.
+#define PAR_CHUNK_MIN	0x00040000
+#define PAR_CHUNK_MAX	0x01000000
+// Parsed chunks held for ordered delivery per thread. Also the number of
+// segments per thread when splitting an array.
+#define PAR_SLOTS	4
+// Bytes looked at when guessing where an array element starts.
+#define SPLIT_WINDOW	0x00040000
+
+// Parses newline delimited JSON with thread_cnt threads, including the
+// calling thread, and passes each value to cb. If ordered is true the values
+// are passed in the order they appear, one at a time. Otherwise each thread
+// calls cb as soon as it has a value so cb must be thread safe. A
+// thread_cnt of zero or less uses one thread per online processor.
+extern void	_ojc_parse_parallel(ojcErr err, const char *json, size_t len, int thread_cnt, ojcParseCallback cb, void *ctx, bool ordered);
+
+// Parses a document that is one large top level array by splitting it into
+// segments between elements and parsing those on thread_cnt threads. The
+// elements are joined into one array returned in *valp or, if cb is not
+// NULL, passed to cb in order. Returns false without parsing anything if the
+// JSON is not an array or too small to split.
+extern bool	_ojc_parse_split(ojcErr err, const char *json, size_t len, int thread_cnt, ojcParseCallback cb, void *ctx, ojcVal *valp);
+
+#endif /* __OJC_PARALLEL_H__ */
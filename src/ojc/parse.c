@@ -33,63 +33,125 @@
 #include <stdarg.h>
 #include <string.h>
 #include <unistd.h>
-#include <math.h>
 
 #include "ojc.h"
 #include "parse.h"
-#include "buf.h"
+#include "index.h"
+#include "intern.h"
+#include "num.h"
 #include "val.h"
 
 #define EXP_MAX		1023
-#define DEC_MAX		14
-#define DIV_MAX		100000000000000000LL
-#define BIGGISH		922337203685477580LL
+#define DEC_MAX		15
 #ifndef	INT64_MAX
 #define INT64_MAX       9223372036854775807LL
 #endif
 
 void	ojc_set_error_at(ParseInfo pi, ojcErrCode code, const char* file, int line, const char *format, ...);
 
-static void
-skip_comment(ParseInfo pi) {
-    char	c = ojc_reader_get(&pi->err, &pi->rd);
+// Comments are skipped a span of the buffer at a time. Each returns false if
+// the input or a NUL ends the comment.
+static bool
+skip_block_comment(ParseInfo pi) {
+    const char	*s;
+    const char	*end;
+    size_t	len;
 
-    if ('*' == c) {
-	while ('\0' != (c = ojc_reader_get(&pi->err, &pi->rd))) {
-	    if ('*' == c) {
-		c = ojc_reader_get(&pi->err, &pi->rd);
-		if ('/' == c) {
-		    return;
+    while (ojc_reader_span(&pi->err, &pi->rd, &s, &len)) {
+	for (end = s + len; s < end; s++) {
+	    if ('\0' == *s) {
+		pi->rd.tail = (char*)s + 1;
+		return false;
+	    }
+	    if ('*' != *s) {
+		continue;
+	    }
+	    if (s + 1 == end) {
+		// Read more to see if the '*' ends the comment.
+		if (!ojc_reader_refill(&pi->err, &pi->rd, s)) {
+		    pi->rd.tail = pi->rd.read_end;
+		    return false;
 		}
+		break;
+	    }
+	    if ('/' == s[1]) {
+		pi->rd.tail = (char*)s + 2;
+		return true;
 	    }
 	}
-    } else if ('/' == c) {
-	while ('\0' != (c = ojc_reader_get(&pi->err, &pi->rd))) {
-	    switch (c) {
+	if (s == end) {
+	    pi->rd.tail = (char*)end;
+	}
+    }
+    return false;
+}
+
+static bool
+skip_line_comment(ParseInfo pi) {
+    const char	*s;
+    const char	*end;
+    size_t	len;
+
+    while (ojc_reader_span(&pi->err, &pi->rd, &s, &len)) {
+	for (end = s + len; s < end; s++) {
+	    switch (*s) {
 	    case '\n':
 	    case '\r':
 	    case '\f':
+		pi->rd.tail = (char*)s + 1;
+		return true;
 	    case '\0':
-		return;
+		pi->rd.tail = (char*)s + 1;
+		return false;
 	    default:
 		break;
 	    }
 	}
+	pi->rd.tail = (char*)end;
+    }
+    return false;
+}
+
+static void
+skip_comment(ParseInfo pi) {
+    char	c = ojc_reader_get(&pi->err, &pi->rd);
+    bool	done;
+
+    if ('*' == c) {
+	done = skip_block_comment(pi);
+    } else if ('/' == c) {
+	done = skip_line_comment(pi);
     } else {
 	ojc_set_error_at(pi, OJC_PARSE_ERR, __FILE__, __LINE__, "invalid comment format");
+	return;
     }
-    if ('\0' == c) {
+    if (!done) {
 	ojc_set_error_at(pi, OJC_INCOMPLETE_ERR, __FILE__, __LINE__, "comment not terminated");
-	return;
     }
 }
 
+// Refills take as many as the parse has used so far so large documents go to
+// the caches less often while small ones do not take more than they need.
+static inline size_t
+batch_size(size_t *madep, size_t min) {
+    size_t	cnt = *madep;
+
+    if (cnt < min) {
+	cnt = min;
+    } else if (MAG_SIZE < cnt) {
+	cnt = MAG_SIZE;
+    }
+    *madep += cnt;
+
+    return cnt;
+}
+
 static ojcVal
 get_val(ParseInfo pi, ojcValType type) {
     ojcVal	v;
 
     if (0 == pi->free_vals.head) {
-	_ojc_val_create_batch(32, &pi->free_vals);
+	_ojc_val_create_batch(batch_size(&pi->vals_made, 32), &pi->free_vals);
     }
     v = pi->free_vals.head;
     pi->free_vals.head = v->next;
@@ -113,7 +175,7 @@ get_bstr(ParseInfo pi) {
 
     if (0 == pi->free_bstrs.head) {
 	pi->free_bstrs.tail = 0;
-	_ojc_bstr_create_batch(16, &pi->free_bstrs);
+	_ojc_bstr_create_batch(batch_size(&pi->bstrs_made, 16), &pi->free_bstrs);
     }
     v = pi->free_bstrs.head;
     pi->free_bstrs.head = v->next;
@@ -123,14 +185,36 @@ get_bstr(ParseInfo pi) {
     return v;
 }
 
+// A predicted key remembers its interned key so the table is only searched
+// the first time.
+static inline const char*
+intern_key(ShapeKey slot, const char *key, int klen) {
+    const char	*ikey;
+
+    if (NULL != slot && NULL != slot->ikey) {
+	return slot->ikey;
+    }
+    if (NULL != (ikey = _ojc_intern(key, klen)) && NULL != slot) {
+	slot->ikey = ikey;
+    }
+    return ikey;
+}
+
 static void
 pi_object_nappend(ParseInfo pi, ojcVal object, ojcVal val) {
     const char	*key = pi->key;
+    const char	*ikey;
     int		klen = pi->klen;
 
     val->next = 0;
     val->key_len = (uint16_t)klen;
-    if ((int)sizeof(union _Bstr) <= klen) {
+    if (ojc_intern_keys && NULL != (ikey = intern_key(pi->kslot, key, klen))) {
+	val->key.str = (char*)ikey;
+	val->key_len |= KEY_REF_FLAG | KEY_INTERN_FLAG;
+    } else if (pi->borrow && NULL == pi->kslot && !pi->kalloc && key != pi->karray && klen < (int)KEY_INTERN_FLAG) {
+	val->key.str = (char*)key;
+	val->key_len |= KEY_REF_FLAG;
+    } else if ((int)sizeof(union _Bstr) <= klen) {
 	if ((int)KEY_BIG <= klen) {
 	    val->key_len = KEY_BIG;
 	}
@@ -138,8 +222,14 @@ pi_object_nappend(ParseInfo pi, ojcVal object, ojcVal val) {
 	val->key.str[klen] = '\0';
     } else if ((int)sizeof(val->key.ca) <= klen) {
 	val->key.bstr = get_bstr(pi);
-	memcpy(val->key.bstr->ca, key, klen);
-	val->key.bstr->ca[klen] = '\0';
+	if (NULL != pi->kslot) { // zero padded so a fixed size copy is faster
+	    memcpy(val->key.bstr->ca, key, SHAPE_KEY_LEN);
+	} else {
+	    memcpy(val->key.bstr->ca, key, klen);
+	    val->key.bstr->ca[klen] = '\0';
+	}
+    } else if (NULL != pi->kslot) {
+	memcpy(val->key.ca, key, sizeof(val->key.ca));
     } else {
 	memcpy(val->key.ca, key, klen);
 	val->key.ca[klen] = '\0';
@@ -173,6 +263,7 @@ add_value(ParseInfo pi, ojcVal val) {
 	    pi->key = 0;
 	    pi->klen = 0;
 	    pi->kalloc = false;
+	    pi->kslot = NULL;
 	    parent->expect = NEXT_OBJECT_COMMA;
 	    break;
 	case NEXT_OBJECT_NEW:
@@ -188,24 +279,170 @@ add_value(ParseInfo pi, ojcVal val) {
     }
 }
 
+static const char	esc_chars[256] = {
+    ['n'] = '\n',
+    ['r'] = '\r',
+    ['t'] = '\t',
+    ['f'] = '\f',
+    ['b'] = '\b',
+    ['"'] = '"',
+    ['/'] = '/',
+    ['\\'] = '\\',
+};
+
+static const uint8_t	hex_vals[256] = {
+    ['0'] = 0, ['1'] = 1, ['2'] = 2, ['3'] = 3, ['4'] = 4,
+    ['5'] = 5, ['6'] = 6, ['7'] = 7, ['8'] = 8, ['9'] = 9,
+    ['a'] = 10, ['b'] = 11, ['c'] = 12, ['d'] = 13, ['e'] = 14, ['f'] = 15,
+    ['A'] = 10, ['B'] = 11, ['C'] = 12, ['D'] = 13, ['E'] = 14, ['F'] = 15,
+};
+
+static inline uint32_t
+hex4(const char *s) {
+    return ((uint32_t)hex_vals[(uint8_t)s[0]] << 12) |
+	((uint32_t)hex_vals[(uint8_t)s[1]] << 8) |
+	((uint32_t)hex_vals[(uint8_t)s[2]] << 4) |
+	(uint32_t)hex_vals[(uint8_t)s[3]];
+}
+
+// The escape sequences in str have already been checked by read_escape() so
+// there is no error checking here. Runs without escapes are copied in bulk.
+// The result is never longer than str so dst needs len + 1 bytes and dst may
+// be str itself. Returns the unescaped length.
+static int
+unescape(char *dst, const char *str, int len) {
+    const char	*end = str + len;
+    const char	*bs;
+    char	*d = dst;
+    uint32_t	code;
+
+    while (str < end) {
+	if (NULL == (bs = memchr(str, '\\', end - str))) {
+	    bs = end;
+	}
+	memmove(d, str, bs - str);
+	d += bs - str;
+	if (end <= bs) {
+	    break;
+	}
+	if ('u' != bs[1]) {
+	    *d++ = esc_chars[(uint8_t)bs[1]];
+	    str = bs + 2;
+	    continue;
+	}
+	code = hex4(bs + 2);
+	str = bs + 6;
+	if (0x0000D800 <= code && code <= 0x0000DFFF) {
+	    code = ((((code - 0x0000D800) & 0x000003FF) << 10) |
+		    ((hex4(str + 2) - 0x0000DC00) & 0x000003FF)) + 0x00010000;
+	    str += 6;
+	}
+	if (0x0000007F >= code) {
+	    *d++ = (char)code;
+	} else if (0x000007FF >= code) {
+	    *d++ = 0xC0 | (code >> 6);
+	    *d++ = 0x80 | (0x3F & code);
+	} else if (0x0000FFFF >= code) {
+	    *d++ = 0xE0 | (code >> 12);
+	    *d++ = 0x80 | ((code >> 6) & 0x3F);
+	    *d++ = 0x80 | (0x3F & code);
+	} else {
+	    *d++ = 0xF0 | (code >> 18);
+	    *d++ = 0x80 | ((code >> 12) & 0x3F);
+	    *d++ = 0x80 | ((code >> 6) & 0x3F);
+	    *d++ = 0x80 | (0x3F & code);
+	}
+    }
+    *d = '\0';
+
+    return (int)(d - dst);
+}
+
+// Unescapes str in place and terminates it, writing over the closing quote
+// if nothing was escaped. Returns the new length. An escaped newline becomes
+// a real one so the lines up to the end of the string are counted before it
+// is rewritten.
+static inline int
+insitu_str(ParseInfo pi, const char *str, int len, bool esc) {
+    if (esc) {
+	ojc_reader_drop(&pi->rd, pi->rd.tail - pi->rd.head);
+	pi->rd.head = pi->rd.tail;
+	return unescape((char*)str, str, len);
+    }
+    ((char*)str)[len] = '\0';
+
+    return len;
+}
+
+// Copies or, if esc is true, unescapes str into the value storage. The
+// storage is picked for the escaped length. If the unescaped string is short
+// enough for a smaller size class it is moved so the storage still matches
+// str_len.
 static ojcVal
-get_str_val(ParseInfo pi, const char *str, int len) {
+get_str_val(ParseInfo pi, const char *str, int len, bool esc) {
     ojcVal	val = get_val(pi, OJC_STRING);
+    Bstr	bstr;
+    char	*big;
 
     if (STR_BIG < (int64_t)len){
 	ojc_set_error_at(pi, OJC_PARSE_ERR, __FILE__, __LINE__, "string length of %d is over the maximum string size if %d bytes", len, STR_BIG);
 	return NULL;
     }
-    val->str_len = len;
+    if (pi->insitu) {
+	len = insitu_str(pi, str, len, esc);
+	val->str.str = (char*)str;
+	val->str_len = len | STR_REF_FLAG;
+	return val;
+    }
+    if (!esc) {
+	val->str_len = len;
+	if (pi->borrow) {
+	    val->str.str = (char*)str;
+	    val->str_len |= STR_REF_FLAG;
+	} else if ((int)sizeof(union _Bstr) <= len) {
+	    val->str.str = strndup(str, len);
+	} else if ((int)sizeof(val->str.ca) <= len) {
+	    val->str.bstr = get_bstr(pi);
+	    memcpy(val->str.bstr->ca, str, len);
+	    val->str.bstr->ca[len] = '\0';
+	} else {
+	    memcpy(val->str.ca, str, len);
+	    val->str.ca[len] = '\0';
+	}
+	return val;
+    }
     if ((int)sizeof(union _Bstr) <= len) {
-	val->str.str = strndup(str, len);
+	big = (char*)malloc(len + 1);
+	len = unescape(big, str, len);
+	val->str_len = len;
+	if ((int)sizeof(union _Bstr) <= len) {
+	    val->str.str = big;
+	    return val;
+	}
+	// Rare enough that a copy is fine.
+	if ((int)sizeof(val->str.ca) <= len) {
+	    val->str.bstr = get_bstr(pi);
+	    memcpy(val->str.bstr->ca, big, len + 1);
+	} else {
+	    memcpy(val->str.ca, big, len + 1);
+	}
+	free(big);
     } else if ((int)sizeof(val->str.ca) <= len) {
-	val->str.bstr = get_bstr(pi);
-	memcpy(val->str.bstr->ca, str, len);
-	val->str.bstr->ca[len] = '\0';
+	bstr = get_bstr(pi);
+	len = unescape(bstr->ca, str, len);
+	val->str_len = len;
+	if ((int)sizeof(val->str.ca) <= len) {
+	    val->str.bstr = bstr;
+	} else {
+	    memcpy(val->str.ca, bstr->ca, len + 1);
+	    bstr->next = pi->free_bstrs.head;
+	    pi->free_bstrs.head = bstr;
+	    if (NULL == pi->free_bstrs.tail) {
+		pi->free_bstrs.tail = bstr;
+	    }
+	}
     } else {
-	memcpy(val->str.ca, str, len);
-	val->str.ca[len] = '\0';
+	val->str_len = unescape(val->str.ca, str, len);
     }
     return val;
 }
@@ -223,42 +460,97 @@ get_word_val(ParseInfo pi, const char *str, int len) {
     return val;
 }
 
+// Checks the key against the key at the same position in the last object at
+// the same depth. If it is not the same it replaces the remembered key. The
+// remembered key is returned unless the key can not be remembered.
+static ShapeKey
+shape_key(ParseInfo pi, ojcVal parent, const char *str, int len, bool esc) {
+    size_t	depth = stack_size(&pi->stack) - 1;
+    Shape	sh;
+    ShapeKey	sk;
+
+    if (SHAPE_DEPTH <= depth) {
+	return NULL;
+    }
+    sh = pi->shapes + depth;
+    if (NEXT_OBJECT_NEW == parent->expect) {
+	sh->pos = 0;
+    }
+    if (SHAPE_KEYS <= sh->pos) {
+	return NULL;
+    }
+    sk = sh->keys + sh->pos++;
+    if (!esc && len == sk->len && 0 == memcmp(str, sk->str, len)) {
+	return sk;
+    }
+    if (esc || SHAPE_KEY_LEN <= len) {
+	sk->len = -1;
+	return NULL;
+    }
+    memset(sk->str, 0, sizeof(sk->str));
+    memcpy(sk->str, str, len);
+    sk->len = len;
+    sk->ikey = NULL;
+
+    return sk;
+}
+
 static void
-add_str(ParseInfo pi, const char *str, int len) {
+add_str(ParseInfo pi, const char *str, int len, bool esc) {
     ojcVal	parent = stack_peek(&pi->stack);
 
     if (0 == parent) { // simple add
-	*pi->stack.head = get_str_val(pi, str, len);
+	*pi->stack.head = get_str_val(pi, str, len, esc);
 	
     } else {
 	switch (parent->expect) {
 	case NEXT_ARRAY_NEW:
 	case NEXT_ARRAY_ELEMENT:
-	    ojc_array_append(&pi->err, parent, get_str_val(pi, str, len));
+	    ojc_array_append(&pi->err, parent, get_str_val(pi, str, len, esc));
 	    parent->expect = NEXT_ARRAY_COMMA;
 	    break;
 	case NEXT_OBJECT_NEW:
 	case NEXT_OBJECT_KEY:
-	    if ((int)sizeof(pi->karray) <= len) {
-		pi->key = strndup(str, len);
+	    // Borrowed keys are not copied anyway so only predict if the key
+	    // will be interned.
+	    if ((!pi->borrow || ojc_intern_keys) && NULL != (pi->kslot = shape_key(pi, parent, str, len, esc))) {
+		pi->key = pi->kslot->str;
+		pi->kalloc = false;
+	    } else if (pi->insitu) {
+		len = insitu_str(pi, str, len, esc);
+		pi->key = (char*)str;
+		pi->kalloc = false;
+	    } else if (!esc && pi->borrow) {
+		// Left in the input and not terminated.
+		pi->key = (char*)str;
+		pi->kalloc = false;
+	    } else if ((int)sizeof(pi->karray) <= len) {
+		pi->key = (char*)malloc(len + 1);
 		pi->kalloc = true;
 	    } else {
-		memcpy(pi->karray, str, len);
-		pi->karray[len] = '\0';
 		pi->key = pi->karray;
 		pi->kalloc = false;
 	    }
+	    if (pi->key != str && NULL == pi->kslot) {
+		if (esc) {
+		    len = unescape(pi->key, str, len);
+		} else {
+		    memcpy(pi->key, str, len);
+		    pi->key[len] = '\0';
+		}
+	    }
 	    pi->klen = len;
 	    parent->expect = NEXT_OBJECT_COLON;
 	    break;
 	case NEXT_OBJECT_VALUE:
-	    pi_object_nappend(pi, parent, get_str_val(pi, str, len));
+	    pi_object_nappend(pi, parent, get_str_val(pi, str, len, esc));
 	    if (pi->kalloc) {
 		free(pi->key);
 	    }
 	    pi->key = 0;
 	    pi->klen = 0;
 	    pi->kalloc = false;
+	    pi->kslot = NULL;
 	    parent->expect = NEXT_OBJECT_COMMA;
 	    break;
 	case NEXT_OBJECT_COMMA:
@@ -295,6 +587,7 @@ add_word(ParseInfo pi, const char *str, int len) {
 	    pi->key = 0;
 	    pi->klen = 0;
 	    pi->kalloc = false;
+	    pi->kslot = NULL;
 	    parent->expect = NEXT_OBJECT_COMMA;
 	    break;
 	case NEXT_OBJECT_NEW:
@@ -352,31 +645,44 @@ array_end(ParseInfo pi) {
     }
 }
 
+static inline bool
+word_end(char c) {
+    switch (c) {
+    case ',': 
+    case ']': 
+    case '}': 
+    case ' ':
+    case '\t':
+    case '\f':
+    case '\n':
+    case '\r':
+    case '\0':
+	return true;
+    default:
+	break;
+    }
+    return false;
+}
+
 static void
 read_word(ParseInfo pi) {
-    char	c;
-    bool	reading = true;
+    const char	*s;
+    const char	*end;
+    size_t	len;
+    size_t	wlen = 0;
+    char	c = '\0';
 
     ojc_reader_backup(&pi->rd);
     ojc_reader_protect(&pi->rd);
-    while (reading) {
-	c = ojc_reader_get(&pi->err, &pi->rd);
-	switch (c) {
-	case ',': 
-	case ']': 
-	case '}': 
-	case ' ':
-	case '\t':
-	case '\f':
-	case '\n':
-	case '\r':
-	    ojc_reader_backup(&pi->rd);
-	    reading = false;
-	    break;
-	case '\0':
-	    reading = false;
-	    break;
-	default:
+    while (ojc_reader_span(&pi->err, &pi->rd, &s, &len)) {
+	for (end = s + len; s < end && !word_end(*s); s++) {
+	}
+	pi->rd.tail = (char*)s;
+	wlen = s - pi->rd.start;
+	if (s < end) {
+	    if ('\0' == (c = *s)) {
+		pi->rd.tail++;
+	    }
 	    break;
 	}
     }
@@ -386,11 +692,11 @@ read_word(ParseInfo pi) {
 	} else {
 	    ojc_set_error_at(pi, OJC_PARSE_ERR, __FILE__, __LINE__, "invalid token");
 	}
-    } else if (0 == strncmp("true", pi->rd.start, 4)) {
+    } else if (4 == wlen && 0 == memcmp("true", pi->rd.start, 4)) {
 	add_value(pi, get_val(pi, OJC_TRUE));
-    } else if (0 == strncmp("false", pi->rd.start, 5)) {
+    } else if (5 == wlen && 0 == memcmp("false", pi->rd.start, 5)) {
 	add_value(pi, get_val(pi, OJC_FALSE));
-    } else if (0 == strncmp("null", pi->rd.start, 4)) {
+    } else if (4 == wlen && 0 == memcmp("null", pi->rd.start, 4)) {
 	add_value(pi, get_val(pi, OJC_NULL));
     } else if (ojc_word_ok) {
 	add_word(pi, pi->rd.start, pi->rd.tail - pi->rd.start);
@@ -427,233 +733,229 @@ read_hex(ParseInfo pi) {
     return b;
 }
 
-static void
-unicode_to_chars(ParseInfo pi, Buf buf, uint32_t code) {
-    if (0x0000007F >= code) {
-	buf_append(buf, (char)code);
-    } else if (0x000007FF >= code) {
-	buf_append(buf, 0xC0 | (code >> 6));
-	buf_append(buf, 0x80 | (0x3F & code));
-    } else if (0x0000FFFF >= code) {
-	buf_append(buf, 0xE0 | (code >> 12));
-	buf_append(buf, 0x80 | ((code >> 6) & 0x3F));
-	buf_append(buf, 0x80 | (0x3F & code));
-    } else if (0x001FFFFF >= code) {
-	buf_append(buf, 0xF0 | (code >> 18));
-	buf_append(buf, 0x80 | ((code >> 12) & 0x3F));
-	buf_append(buf, 0x80 | ((code >> 6) & 0x3F));
-	buf_append(buf, 0x80 | (0x3F & code));
-    } else if (0x03FFFFFF >= code) {
-	buf_append(buf, 0xF8 | (code >> 24));
-	buf_append(buf, 0x80 | ((code >> 18) & 0x3F));
-	buf_append(buf, 0x80 | ((code >> 12) & 0x3F));
-	buf_append(buf, 0x80 | ((code >> 6) & 0x3F));
-	buf_append(buf, 0x80 | (0x3F & code));
-    } else if (0x7FFFFFFF >= code) {
-	buf_append(buf, 0xFC | (code >> 30));
-	buf_append(buf, 0x80 | ((code >> 24) & 0x3F));
-	buf_append(buf, 0x80 | ((code >> 18) & 0x3F));
-	buf_append(buf, 0x80 | ((code >> 12) & 0x3F));
-	buf_append(buf, 0x80 | ((code >> 6) & 0x3F));
-	buf_append(buf, 0x80 | (0x3F & code));
-    } else {
-	ojc_set_error_at(pi, OJC_PARSE_ERR, __FILE__, __LINE__, "invalid Unicode character");
-    }
-}
-
-// entered at backslash
-static void
-read_escaped_str(ParseInfo pi) {
-    struct _Buf	buf;
-    char	c;
+// Entered after the backslash. The escape sequence is only checked here. The
+// string is unescaped once the closing quote has been found.
+static bool
+read_escape(ParseInfo pi) {
     uint32_t	code;
+    char	c;
 
-    buf_init(&buf, 0);
-    if (pi->rd.start < pi->rd.tail) {
-	buf_append_string(&buf, pi->rd.start, pi->rd.tail - pi->rd.start);
-    }
-    while ('"' != (c = ojc_reader_get(&pi->err, &pi->rd))) {
-	if ('\0' == c) {
-	    ojc_set_error_at(pi, OJC_INCOMPLETE_ERR, __FILE__, __LINE__, "quoted string not terminated");
-	    buf_cleanup(&buf);
-	    return;
-	} else if ('\\' == c) {
+    switch (ojc_reader_get(&pi->err, &pi->rd)) {
+    case 'n':
+    case 'r':
+    case 't':
+    case 'f':
+    case 'b':
+    case '"':
+    case '/':
+    case '\\':
+	break;
+    case 'u':
+	if (0 == (code = read_hex(pi)) && OJC_OK != pi->err.code) {
+	    return false;
+	}
+	if (0x0000D800 <= code && code <= 0x0000DFFF) {
 	    c = ojc_reader_get(&pi->err, &pi->rd);
-	    switch (c) {
-	    case 'n':	buf_append(&buf, '\n');	break;
-	    case 'r':	buf_append(&buf, '\r');	break;
-	    case 't':	buf_append(&buf, '\t');	break;
-	    case 'f':	buf_append(&buf, '\f');	break;
-	    case 'b':	buf_append(&buf, '\b');	break;
-	    case '"':	buf_append(&buf, '"');	break;
-	    case '/':	buf_append(&buf, '/');	break;
-	    case '\\':	buf_append(&buf, '\\');	break;
-	    case 'u':
-		if (0 == (code = read_hex(pi)) && OJC_OK != pi->err.code) {
-		    buf_cleanup(&buf);
-		    return;
-		}
-		if (0x0000D800 <= code && code <= 0x0000DFFF) {
-		    uint32_t	c1 = (code - 0x0000D800) & 0x000003FF;
-		    uint32_t	c2;
-		    char	ch2;
-
-		    c = ojc_reader_get(&pi->err, &pi->rd);
-		    ch2 = ojc_reader_get(&pi->err, &pi->rd);
-		    if ('\\' != c || 'u' != ch2) {
-			ojc_set_error_at(pi, OJC_PARSE_ERR, __FILE__, __LINE__, "invalid escaped character");
-			buf_cleanup(&buf);
-			return;
-		    }
-		    if (0 == (c2 = read_hex(pi)) && OJC_OK != pi->err.code) {
-			buf_cleanup(&buf);
-			return;
-		    }
-		    c2 = (c2 - 0x0000DC00) & 0x000003FF;
-		    code = ((c1 << 10) | c2) + 0x00010000;
-		}
-		unicode_to_chars(pi, &buf, code);
-		if (OJC_OK != pi->err.code) {
-		    buf_cleanup(&buf);
-		    return;
-		}
-		break;
-	    default:
+	    if ('\\' != c || 'u' != ojc_reader_get(&pi->err, &pi->rd)) {
 		ojc_set_error_at(pi, OJC_PARSE_ERR, __FILE__, __LINE__, "invalid escaped character");
-		buf_cleanup(&buf);
-		return;
+		return false;
+	    }
+	    if (0 == read_hex(pi) && OJC_OK != pi->err.code) {
+		return false;
 	    }
-	} else {
-	    buf_append(&buf, c);
 	}
+	break;
+    default:
+	ojc_set_error_at(pi, OJC_PARSE_ERR, __FILE__, __LINE__, "invalid escaped character");
+	return false;
     }
-    add_str(pi, buf.head, buf_len(&buf));
-    buf_cleanup(&buf);
+    return true;
 }
 
+// Strings are scanned a block at a time up to the next quote, backslash, or
+// control character in the buffer. A string that runs past the end of the
+// buffer is protected so it stays in the buffer when more is read. Escape
+// sequences are checked as they are reached and the string is unescaped by
+// add_str() after the closing quote.
 static void
 read_str(ParseInfo pi) {
-    char	c;
+    const char	*s;
+    size_t	len;
+    bool	esc = false;
 
     ojc_reader_protect(&pi->rd);
-    while ('"' != (c = ojc_reader_get(&pi->err, &pi->rd))) {
-	if ('\0' == c) {
+    while (true) {
+	if (!ojc_reader_span(&pi->err, &pi->rd, &s, &len)) {
 	    ojc_set_error_at(pi, OJC_INCOMPLETE_ERR, __FILE__, __LINE__, "quoted string not terminated");
 	    return;
-	} else if ('\\' == c) {
-	    ojc_reader_backup(&pi->rd);
-	    read_escaped_str(pi);
-	    ojc_reader_release(&pi->rd);
+	}
+	s = simd_scan_str(s, s + len);
+	pi->rd.tail = (char*)s;
+	if (pi->rd.read_end <= s) {
+	    continue;
+	}
+	switch (*s) {
+	case '"':
+	    pi->rd.tail++;
+	    add_str(pi, pi->rd.start, pi->rd.tail - pi->rd.start - 1, esc);
+	    return;
+	case '\\':
+	    pi->rd.tail++;
+	    if (!read_escape(pi)) {
+		return;
+	    }
+	    esc = true;
+	    break;
+	case '\n':
+	    pi->rd.tail++;
+	    if (!ojc_parse_newline_ok) {
+		ojc_set_error_at(pi, OJC_PARSE_ERR, __FILE__, __LINE__, "invalid character in string");
+		return;
+	    }
+	    break;
+	case '\0':
+	    ojc_set_error_at(pi, OJC_INCOMPLETE_ERR, __FILE__, __LINE__, "quoted string not terminated");
+	    return;
+	default:
+	    pi->rd.tail++;
+	    ojc_set_error_at(pi, OJC_PARSE_ERR, __FILE__, __LINE__, "invalid character in string");
 	    return;
 	}
     }
-    add_str(pi, pi->rd.start, pi->rd.tail - pi->rd.start - 1);
-    ojc_reader_release(&pi->rd);
 }
 
-static void
-read_num(ParseInfo pi) {
-    ojcVal	val;
-    int		zero_cnt = 0;
-    int64_t	i = 0;
-    int64_t	num = 0;
-    int64_t	div = 1;
-    long	exp = 0;
-    int		dec_cnt = 0;
-    int		big = 0;
-    int		neg = 0;
-    char	c;
+// A number as it is scanned. Up to 19 significant digits are collected in
+// mant, enough for any int64_t and more than a double can hold.
+typedef struct _Num {
+    uint64_t	mant;
+    int		cnt;		// digits from the first non-zero digit
+    int		last;		// cnt at the last non-zero digit
+    int		exp10;		// power of 10 to apply to mant
+    int		frac_cnt;
+    long	exp;
+    bool	neg;
+    bool	big;
+} *Num;
 
-    ojc_reader_protect(&pi->rd);
-    c = ojc_reader_get(&pi->err, &pi->rd);
-    if ('-' == c) {
-	c = ojc_reader_get(&pi->err, &pi->rd);
-	neg = 1;
-    } else if ('+' == c) {
-	c = ojc_reader_get(&pi->err, &pi->rd);
-    }
-    for (; '0' <= c && c <= '9'; c = ojc_reader_get(&pi->err, &pi->rd)) {
-	dec_cnt++;
-	if (big) {
-	    big++;
-	} else {
-	    int	d = (c - '0');
+static const char*
+scan_digits(const char *p, const char *end, Num num, bool frac) {
+    const char	*t;
+    uint32_t	d;
 
-	    if (0 == d) {
-		zero_cnt++;
-	    } else {
-		zero_cnt = 0;
-	    }
-	    if (BIGGISH < i && (INT64_MAX - (int64_t)d) / 10LL <= i) {
-		big = 1;
-	    } else {
-		i = i * 10 + d;
-	    }
+    for (; 0 == num->cnt && p < end && '0' == *p; p++) {
+	if (frac) {
+	    num->exp10--;
 	}
     }
-    if ('.' == c) {
-	c = ojc_reader_get(&pi->err, &pi->rd);
-	for (; '0' <= c && c <= '9'; c = ojc_reader_get(&pi->err, &pi->rd)) {
-	    int	d = (c - '0');
-
-	    if (0 == d) {
-		zero_cnt++;
-	    } else {
-		zero_cnt = 0;
+    while (true) {
+	if (num->cnt <= 11 && p + 8 <= end && ojc_num_eight_digits(p)) {
+	    if (0 != (d = ojc_num_parse_eight(p))) {
+		for (t = p + 7; '0' == *t; t--) {
+		}
+		num->last = num->cnt + (int)(t - p) + 1;
 	    }
-	    dec_cnt++;
-	    if ((BIGGISH < num && (INT64_MAX - (int64_t)d) / 10LL <= num) ||
-		DIV_MAX <= div || DEC_MAX < dec_cnt - zero_cnt) {
-		big = 1;
-	    } else {
-		num = num * 10 + d;
-		div *= 10;
+	    num->mant = num->mant * 100000000ULL + d;
+	    num->cnt += 8;
+	    if (frac) {
+		num->exp10 -= 8;
 	    }
+	    p += 8;
+	    continue;
+	}
+	if (end <= p || *p < '0' || '9' < *p) {
+	    break;
+	}
+	d = *p++ - '0';
+	if (num->cnt < 19) {
+	    num->mant = num->mant * 10 + d;
+	    if (frac) {
+		num->exp10--;
+	    }
+	} else if (!frac) {
+	    num->exp10++;
+	}
+	num->cnt++;
+	if (0 != d) {
+	    num->last = num->cnt;
 	}
     }
-    if ('e' == c || 'E' == c) {
-	int	eneg = 0;
+    return p;
+}
 
-	c = ojc_reader_get(&pi->err, &pi->rd);
-	if ('-' == c) {
-	    c = ojc_reader_get(&pi->err, &pi->rd);
-	    eneg = 1;
-	} else if ('+' == c) {
-	    c = ojc_reader_get(&pi->err, &pi->rd);
+// Returns a pointer to the character after the number or end if the number
+// runs to the end.
+static const char*
+scan_num(const char *p, const char *end, Num num) {
+    const char	*f;
+
+    if (p < end && '-' == *p) {
+	num->neg = true;
+	p++;
+    } else if (p < end && '+' == *p) {
+	p++;
+    }
+    p = scan_digits(p, end, num, false);
+    if (p < end && '.' == *p) {
+	f = ++p;
+	p = scan_digits(p, end, num, true);
+	num->frac_cnt = (int)(p - f);
+    }
+    if (p < end && ('e' == *p || 'E' == *p)) {
+	bool	eneg = false;
+
+	p++;
+	if (p < end && '-' == *p) {
+	    eneg = true;
+	    p++;
+	} else if (p < end && '+' == *p) {
+	    p++;
 	}
-	for (; '0' <= c && c <= '9'; c = ojc_reader_get(&pi->err, &pi->rd)) {
-	    exp = exp * 10 + (c - '0');
-	    if (EXP_MAX <= exp) {
-		big = 1;
+	for (; p < end && '0' <= *p && *p <= '9'; p++) {
+	    if (num->exp < EXP_MAX) {
+		num->exp = num->exp * 10 + (*p - '0');
 	    }
 	}
+	if (EXP_MAX <= num->exp) {
+	    num->big = true;
+	}
 	if (eneg) {
-	    exp = -exp;
+	    num->exp = -num->exp;
 	}
     }
-    dec_cnt -= zero_cnt;
-    if ('\0' != c) {
-	ojc_reader_backup(&pi->rd);
+    return p;
+}
+
+// The number is converted as it is scanned. If it runs to the end of the
+// buffer more is read and the scan starts over from the protected start.
+static void
+read_num(ParseInfo pi) {
+    struct _Num	num;
+    ojcVal	val;
+    const char	*p;
+
+    ojc_reader_protect(&pi->rd);
+    while (true) {
+	memset(&num, 0, sizeof(num));
+	p = scan_num(pi->rd.start, pi->rd.read_end, &num);
+	if (p < pi->rd.read_end || pi->rd.eof) {
+	    break;
+	}
+	ojc_reader_refill(&pi->err, &pi->rd, pi->rd.start);
     }
-    if (!big && 1 == div && 0 == exp) { // fixnum
-	if (neg) {
-	    i = -i;
+    pi->rd.tail = (char*)p;
+    if (!num.big && 0 == num.frac_cnt && 0 == num.exp) { // fixnum
+	// The most negative fixnum has no positive counterpart.
+	if (19 < num.cnt || (uint64_t)INT64_MAX + (num.neg ? 1 : 0) < num.mant) {
+	    val = ojc_create_number(pi->rd.start, pi->rd.tail - pi->rd.start);
+	} else {
+	    val = get_val(pi, OJC_FIXNUM);
+	    val->fixnum = num.neg ? (int64_t)(0 - num.mant) : (int64_t)num.mant;
 	}
-	val = get_val(pi, OJC_FIXNUM);
-	val->fixnum = i;
-    } else if (big || ojc_decimal_as_number) {
+    } else if (num.big || ojc_decimal_as_number || DEC_MAX < num.last) {
 	val = ojc_create_number(pi->rd.start, pi->rd.tail - pi->rd.start);
     } else { // decimal
-	double	d = (double)i + (double)num / (double)div;
-
-	if (neg) {
-	    d = -d;
-	}
-	if (0 != exp) {
-	    d *= pow(10.0, exp);
-	}
 	val = get_val(pi, OJC_DECIMAL);
-	val->dub = d;
+	val->dub = ojc_num_to_double(num.mant, num.exp10 + (int)num.exp, num.neg, pi->rd.start, pi->rd.tail - pi->rd.start);
     }
     add_value(pi, val);
     ojc_reader_release(&pi->rd);
@@ -685,8 +987,8 @@ colon(ParseInfo pi) {
     }
 }
 
-static void
-pi_val_destroy(ParseInfo pi, ojcVal val) {
+void
+ojc_parse_val_destroy(ParseInfo pi, ojcVal val) {
     struct _List	freed = LIST_INIT;
     struct _MList	freed_bstrs = LIST_INIT;
 
@@ -711,6 +1013,22 @@ pi_val_destroy(ParseInfo pi, ojcVal val) {
     }
 }
 
+// Called when the stack is empty. Passes the completed value to the each
+// callback if there is one or queues it for the callback threads.
+static void
+each_val(ParseInfo pi) {
+    ojcVal	val = stack_head(&pi->stack);
+
+    if (NULL != val) {
+	if (NULL != pi->dispatch) {
+	    _ojc_dispatch_push(pi->dispatch, &pi->err, val);
+	} else if (pi->each_cb(&pi->err, val, pi->each_ctx)) {
+	    ojc_parse_val_destroy(pi, val);
+	}
+	*pi->stack.head = 0;
+    }
+}
+
 void
 ojc_parse(ParseInfo pi) {
     char	c;
@@ -762,14 +1080,7 @@ ojc_parse(ParseInfo pi) {
 	case '\0':
 	    if (stack_empty(&pi->stack)) {
 		if (NULL != pi->each_cb) {
-		    ojcVal	val = stack_head(&pi->stack);
-
-		    if (0 != val) {
-			if (pi->each_cb(&pi->err, val, pi->each_ctx)) {
-			    pi_val_destroy(pi, val);
-			}
-			*pi->stack.head = 0;
-		    }
+		    each_val(pi);
 		}
 	    } else {
 		ojc_set_error_at(pi, OJC_INCOMPLETE_ERR, __FILE__, __LINE__, "parse terminated early");
@@ -792,16 +1103,322 @@ ojc_parse(ParseInfo pi) {
 		// this is a more tolerant approach.
 		break;
 	    } else {
-		ojcVal	val = stack_head(&pi->stack);
+		each_val(pi);
+	    }
+	}
+    }
+}
+
+// Returns true if the token starting at s ends before end so it can be read
+// without reading more. If not, how far the token was scanned is kept in pi
+// so the next call picks up there instead of scanning it all again.
+static bool
+token_complete(ParseInfo pi, const char *s, const char *end) {
+    const char	*p = s + pi->scan;
+
+    switch (*s) {
+    case '"':
+	if (0 == pi->scan) {
+	    p++;
+	}
+	if (pi->scan_esc) {
+	    if (end <= p) {
+		return false;
+	    }
+	    p++;
+	    pi->scan_esc = false;
+	}
+	for (; p < end; p++) {
+	    if ('\\' == *p) {
+		if (end <= ++p) {
+		    pi->scan_esc = true;
+		    break;
+		}
+	    } else if ('"' == *p) {
+		pi->scan = 0;
+		return true;
+	    }
+	}
+	break;
+    case '/':
+	if (end <= s + 1) {
+	    return false;
+	}
+	if ('*' == s[1]) {
+	    if (p < s + 2) {
+		p = s + 2;
+	    }
+	    for (; p + 1 < end; p++) {
+		if ('*' == *p && '/' == p[1]) {
+		    pi->scan = 0;
+		    return true;
+		}
+	    }
+	    break;
+	}
+	if ('/' == s[1]) {
+	    if (p < s + 2) {
+		p = s + 2;
+	    }
+	    for (; p < end; p++) {
+		if ('\n' == *p || '\r' == *p || '\f' == *p) {
+		    pi->scan = 0;
+		    return true;
+		}
+	    }
+	    break;
+	}
+	return true;
+    case '{':
+    case '}':
+    case '[':
+    case ']':
+    case ',':
+    case ':':
+    case '\0':
+	return true;
+    case '+':
+    case '-':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+	if (0 == pi->scan) {
+	    p++;
+	}
+	for (; p < end && NULL != strchr("0123456789.eE+-", *p) && '\0' != *p; p++) {
+	}
+	if (p < end) {
+	    pi->scan = 0;
+	    return true;
+	}
+	break;
+    default:
+	// The same characters that end a word in read_word().
+	for (; p < end; p++) {
+	    switch (*p) {
+	    case ',':
+	    case ']':
+	    case '}':
+	    case ' ':
+	    case '\t':
+	    case '\f':
+	    case '\n':
+	    case '\r':
+	    case '\0':
+		pi->scan = 0;
+		return true;
+	    default:
+		break;
+	    }
+	}
+	break;
+    }
+    pi->scan = p - s;
+
+    return false;
+}
+
+// Parses the tokens in the reader buffer but stops at a token that runs to
+// the end of the buffer unless last is true. That leaves the reader tail at
+// the start of the token so it can be parsed again once more data arrives.
+// The stack, pending key, and line and column are kept in pi between calls.
+void
+ojc_parse_push(ParseInfo pi, bool last) {
+    char	c;
+
+    while (OJC_OK == pi->err.code) {
+	while (pi->rd.tail < pi->rd.read_end && is_white(*pi->rd.tail)) {
+	    ojc_reader_get(&pi->err, &pi->rd);
+	}
+	if (pi->rd.read_end <= pi->rd.tail) {
+	    if (last && !stack_empty(&pi->stack)) {
+		ojc_set_error_at(pi, OJC_INCOMPLETE_ERR, __FILE__, __LINE__, "parse terminated early");
+	    }
+	    break;
+	}
+	if (!last && !token_complete(pi, pi->rd.tail, pi->rd.read_end)) {
+	    break;
+	}
+	c = ojc_reader_get(&pi->err, &pi->rd);
+	switch (c) {
+	case '{':
+	    object_start(pi);
+	    break;
+	case '}':
+	    object_end(pi);
+	    break;
+	case ':':
+	    colon(pi);
+	    break;
+	case '[':
+	    array_start(pi);
+	    break;
+	case ']':
+	    array_end(pi);
+	    break;
+	case ',':
+	    comma(pi);
+	    break;
+	case '"':
+	    read_str(pi);
+	    break;
+	case '+':
+	case '-':
+	case '0':
+	case '1':
+	case '2':
+	case '3':
+	case '4':
+	case '5':
+	case '6':
+	case '7':
+	case '8':
+	case '9':
+	    ojc_reader_backup(&pi->rd);
+	    read_num(pi);
+	    break;
+	case '/':
+	    skip_comment(pi);
+	    break;
+	case '\0':
+	    // A null character separates documents as it ends one in ojc_parse().
+	    if (!stack_empty(&pi->stack)) {
+		ojc_set_error_at(pi, OJC_INCOMPLETE_ERR, __FILE__, __LINE__, "parse terminated early");
+	    }
+	    break;
+	default:
+	    read_word(pi);
+	    break;
+	}
+	if (OJC_OK == pi->err.code && stack_empty(&pi->stack)) {
+	    each_val(pi);
+	}
+    }
+}
 
-		if (NULL != val) {
-		    if (pi->each_cb(&pi->err, val, pi->each_ctx)) {
-			pi_val_destroy(pi, val);
-		    }
-		    *pi->stack.head = 0;
+// Returns true if a word read with read_word() ran over a character that
+// would change the string state in the index.
+static bool
+word_overran(const char *s, const char *end) {
+    for (; s < end; s++) {
+	if (0 != (simd_char_class[(uint8_t)*s] & (CC_QUOTE | CC_OP | CC_SLASH))) {
+	    return true;
+	}
+    }
+    return false;
+}
+
+// Parses a string by walking the structural index built in chunks by
+// ojc_index_build() instead of going through the reader one character at a
+// time. The reader must be a string reader.
+void
+ojc_parse_indexed(ParseInfo pi) {
+    struct _Index	index;
+    const char		*s;
+    const char		*q;
+
+    pi->err.code = 0;
+    *pi->err.msg = '\0';
+    pi->indexed = true;
+    ojc_index_init(&index, pi->rd.tail, pi->rd.read_end);
+    while (NULL != (s = ojc_index_next(&index))) {
+	if (s < pi->rd.tail) { // consumed as part of the previous token
+	    continue;
+	}
+	pi->rd.tail = (char*)s + 1;
+	switch (*s) {
+	case '{':
+	    object_start(pi);
+	    break;
+	case '}':
+	    object_end(pi);
+	    break;
+	case ':':
+	    colon(pi);
+	    break;
+	case '[':
+	    array_start(pi);
+	    break;
+	case ']':
+	    array_end(pi);
+	    break;
+	case ',':
+	    comma(pi);
+	    break;
+	case '"':
+	    // Backslashes in strings are indexed so if the next entry is a
+	    // quote it is the closing quote and there is nothing to unescape.
+	    if (NULL != (q = ojc_index_peek(&index)) && '"' == *q) {
+		index.head++;
+		pi->rd.tail = (char*)q + 1;
+		add_str(pi, s + 1, (int)(q - s - 1), false);
+	    } else {
+		read_str(pi);
+		// An in situ parse may have written over the part of the
+		// string that has not been indexed yet so start indexing
+		// again after the string.
+		if (index.next < pi->rd.tail) {
+		    ojc_index_restart(&index, pi->rd.tail);
 		}
 	    }
+	    break;
+	case '+':
+	case '-':
+	case '0':
+	case '1':
+	case '2':
+	case '3':
+	case '4':
+	case '5':
+	case '6':
+	case '7':
+	case '8':
+	case '9':
+	    pi->rd.tail--;
+	    read_num(pi);
+	    // The rest of something like 12abc is not indexed so start over
+	    // at the character that ended the number.
+	    if (pi->rd.tail < pi->rd.read_end && !ojc_index_delim(*pi->rd.tail)) {
+		ojc_index_restart(&index, pi->rd.tail);
+	    }
+	    break;
+	case '/':
+	    skip_comment(pi);
+	    // Quotes in a comment are not string starts so index again from
+	    // the end of the comment.
+	    ojc_index_restart(&index, pi->rd.tail);
+	    break;
+	default:
+	    read_word(pi);
+	    if (word_overran(s + 1, pi->rd.tail)) {
+		ojc_index_restart(&index, pi->rd.tail);
+	    }
+	    break;
+	}
+	if (OJC_OK != pi->err.code) {
+	    return;
+	}
+	if (stack_empty(&pi->stack)) {
+	    if (NULL == pi->each_cb) {
+		return;
+	    }
+	    each_val(pi);
+	}
+    }
+    pi->rd.tail = pi->rd.read_end;
+    if (stack_empty(&pi->stack)) {
+	if (NULL != pi->each_cb) {
+	    each_val(pi);
 	}
+    } else if (!pi->partial) {
+	ojc_set_error_at(pi, OJC_INCOMPLETE_ERR, __FILE__, __LINE__, "parse terminated early");
     }
 }
 
@@ -809,10 +1426,13 @@ void
 ojc_set_error_at(ParseInfo pi, ojcErrCode code, const char* file, int line, const char *format, ...) {
     va_list	ap;
     char	msg[128];
+    int		rline;
+    int		rcol;
 
     va_start(ap, format);
     vsnprintf(msg, sizeof(msg) - 1, format, ap);
     va_end(ap);
+    ojc_reader_position(&pi->rd, &rline, &rcol);
     pi->err.code = code;
-    snprintf(pi->err.msg, sizeof(pi->err.msg) - 1, "%s at line %d, column %d [%s:%d]", msg, pi->rd.line, pi->rd.col, file, line);
+    snprintf(pi->err.msg, sizeof(pi->err.msg) - 1, "%s at line %d, column %d [%s:%d]", msg, rline, rcol, file, line);
 }
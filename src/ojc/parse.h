@@ -34,10 +34,31 @@
 #include <stdarg.h>
 #include <stdio.h>
 
+#include "dispatch.h"
 #include "ojc.h"
 #include "reader.h"
 #include "val_stack.h"
 
+// Number of object depths, keys per object, and the longest key remembered
+// for predicting keys.
+#define SHAPE_DEPTH	4
+#define SHAPE_KEYS	16
+#define SHAPE_KEY_LEN	32
+
+typedef struct _ShapeKey {
+    const char	*ikey;			// interned key or NULL
+    int		len;			// -1 if nothing is remembered
+    char	str[SHAPE_KEY_LEN];	// zero padded
+} *ShapeKey;
+
+// Keys of the last object seen at a depth in the order they appeared. In a
+// stream of objects with the same keys the next key is usually the one at
+// the same position in the previous object.
+typedef struct _Shape {
+    int			pos;	// position of the next key
+    struct _ShapeKey	keys[SHAPE_KEYS];
+} *Shape;
+
 typedef struct _ParseInfo {
     struct _Reader	rd;
     struct _ojcErr	err;
@@ -45,28 +66,62 @@ typedef struct _ParseInfo {
     struct _ValStack	stack;
     ojcParseCallback	each_cb;
     void		*each_ctx;
+    Dispatch		dispatch;	// if set values are passed to each_cb on other threads
     struct _List	free_vals;
     struct _MList	free_bstrs;
+    size_t		vals_made;	// values taken so far, sets the next batch size
+    size_t		bstrs_made;
     char		*key;
     char		karray[256];
     size_t		klen;
     bool		kalloc;
+    ShapeKey		kslot;	// set if key is a predicted key
+    bool		indexed;
+    bool		borrow;	// strings reference the input buffer when possible
+    bool		insitu;	// strings are unescaped and terminated in the input buffer
+    bool		partial;	// input ends inside the document so running out is not an error
+    size_t		scan;	// bytes of an unfinished pushed token already scanned
+    bool		scan_esc;	// the next byte of an unfinished pushed string is escaped
+    struct _Shape	shapes[SHAPE_DEPTH];
 } *ParseInfo;
 
 extern void	ojc_parse(ParseInfo pi);
+extern void	ojc_parse_indexed(ParseInfo pi);
+extern void	ojc_parse_push(ParseInfo pi, bool last);
+// Destroys val, keeping the freed values and strings in the free lists of pi.
+extern void	ojc_parse_val_destroy(ParseInfo pi, ojcVal val);
 
 inline static void
 parse_init(ojcErr err, ParseInfo pi, ojcParseCallback cb, void *ctx) {
+    Shape	sh;
+    ShapeKey	sk;
+
     ojc_err_init(&pi->err);
     pi->each_cb = cb;
     pi->each_ctx = ctx;
+    pi->dispatch = NULL;
     pi->free_vals.head = NULL;
     pi->free_vals.tail = NULL;
     pi->free_bstrs.head = NULL;
     pi->free_bstrs.tail = NULL;
+    pi->vals_made = 0;
+    pi->bstrs_made = 0;
     pi->key = NULL;
     pi->klen = 0;
     pi->kalloc = false;
+    pi->kslot = NULL;
+    for (sh = pi->shapes; sh < pi->shapes + SHAPE_DEPTH; sh++) {
+	sh->pos = 0;
+	for (sk = sh->keys; sk < sh->keys + SHAPE_KEYS; sk++) {
+	    sk->len = -1;
+	}
+    }
+    pi->indexed = false;
+    pi->borrow = false;
+    pi->insitu = false;
+    pi->partial = false;
+    pi->scan = 0;
+    pi->scan_esc = false;
     stack_init(&pi->stack);
 }
 
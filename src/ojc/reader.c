@@ -33,26 +33,77 @@
 #include <stdio.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
 #if NEEDS_UIO
 #include <sys/uio.h>	
 #endif
 #include <unistd.h>
 #include <time.h>
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/memfd.h>)
+#include <linux/memfd.h>
+#include <sys/syscall.h>
+#define HAVE_MEMFD	1
+#endif
+#endif
 
 #include "ojc.h"
+#include "ahead.h"
 #include "reader.h"
+#include "uring.h"
 
 #define BUF_PAD	4
 
+// Reads that fill the buffer this many times in a row grow it up to
+// ojc_read_buf_max. Reads that use less than a quarter of it this many times
+// in a row shrink it back toward the starting size. A ring is not shrunk
+// since a new one costs a memfd, two mappings, and page faults.
+#define GROW_READS	2
+#define SHRINK_READS	16
+
+#define HUGE_PAGE_SIZE	0x00200000
+
+// The least copied from a lent chunk at a time when a token crosses chunks.
+#define LEND_STEP	64
+
+// How long a follow reader waits for a change before checking whether the
+// file was rotated. Without inotify this is how often the file is polled.
+#define FOLLOW_NOTIFY_MSECS	1000
+#define FOLLOW_POLL_USECS	100000
+
 static bool	read_from_file(ojcErr err, Reader reader);
 static bool	read_from_follow(ojcErr err, Reader reader);
 static bool	read_from_socket(ojcErr err, Reader reader);
 static bool	read_from_str(ojcErr err, Reader reader);
 static bool	read_from_func(ojcErr err, Reader reader);
+static bool	read_from_uring(ojcErr err, Reader reader);
+static bool	read_from_ahead(ojcErr err, Reader reader);
+static bool	read_from_lender(ojcErr err, Reader reader);
+
+// A source that lends chunks it already holds. The parser reads a chunk in
+// place. Only a token that crosses into the next chunk is copied to the side
+// buffer, followed by a little of the next chunk at a time until the token is
+// done, after which the parser goes back to reading the chunk in place.
+typedef struct _Lender {
+    void		*src;
+    ojcLendFunc		lend;
+    ojcReleaseFunc	release;
+    const char		*chunk;	// current chunk or NULL once released
+    size_t		len;
+    size_t		pos;	// bytes of the chunk copied to the side buffer
+    char		*side;
+    size_t		size;	// side buffer size
+} *Lender;
 
 static void
 ojc_reader_init(Reader reader) {
+    reader->mem = NULL;
     reader->head = reader->base;
     *((char*)reader->head) = '\0';
     reader->end = reader->head + sizeof(reader->base) - BUF_PAD;
@@ -62,13 +113,225 @@ ojc_reader_init(Reader reader) {
     reader->start = 0;
     reader->line = 1;
     reader->col = 0;
-    reader->free_head = 0;
+    reader->pos = 0;
+    reader->free_head = BUF_BASE;
+    reader->min_size = sizeof(reader->base);
+    reader->full_reads = 0;
+    reader->small_reads = 0;
     reader->eof = false;
     reader->read_func = 0;
+    reader->uring = NULL;
+    reader->ahead = NULL;
+    reader->lender = NULL;
+    reader->path = NULL;
+    reader->rotated = NULL;
+    reader->notify = -1;
+    reader->watch = -1;
+}
+
+// A ring is one memfd mapped twice back to back so the bytes past the end of
+// the first mapping are the ones at its start. Dropping bytes from the front
+// of the buffer then only moves head and a token that wraps is still
+// contiguous. Returns NULL if a ring can not be made.
+static char*
+ring_alloc(size_t *sizep) {
+#ifdef HAVE_MEMFD
+    size_t	page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t	size = (*sizep + page - 1) & ~(page - 1);
+    char	*ring;
+    int		fd;
+
+    if (0 > (fd = (int)syscall(SYS_memfd_create, "ojc-reader", MFD_CLOEXEC))) {
+	return NULL;
+    }
+    ring = (char*)mmap(NULL, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == ring || 0 != ftruncate(fd, size) ||
+	MAP_FAILED == mmap(ring, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) ||
+	MAP_FAILED == mmap(ring + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0)) {
+	if (MAP_FAILED != ring) {
+	    munmap(ring, size * 2);
+	}
+	close(fd);
+	return NULL;
+    }
+    close(fd);
+    *sizep = size;
+
+    return ring;
+#else
+    return NULL;
+#endif
+}
+
+// Buffers of at least a huge page are mapped so they can be backed by huge
+// pages. The size is rounded up to use all of the mapping.
+static char*
+buf_alloc(size_t *sizep, int *kindp) {
+    char	*buf;
+
+    if (ojc_read_ring && NULL != (buf = ring_alloc(sizep))) {
+	*kindp = BUF_RING;
+	return buf;
+    }
+    if (ojc_read_huge_pages && HUGE_PAGE_SIZE <= *sizep) {
+	size_t	size = (*sizep + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1);
+
+	buf = MAP_FAILED;
+#ifdef MAP_HUGETLB
+	buf = (char*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+	if (MAP_FAILED == buf) {
+	    // No reserved huge pages so ask for transparent ones instead.
+	    buf = (char*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+	    if (MAP_FAILED != buf) {
+		madvise(buf, size, MADV_HUGEPAGE);
+	    }
+#endif
+	}
+	if (MAP_FAILED != buf) {
+	    *sizep = size;
+	    *kindp = BUF_MAP;
+	    return buf;
+	}
+    }
+    *kindp = BUF_MALLOC;
+
+    return (char*)malloc(*sizep);
+}
+
+static void
+buf_free(Reader reader) {
+    switch (reader->free_head) {
+    case BUF_MALLOC:
+	free(reader->mem);
+	break;
+    case BUF_MAP:
+	munmap(reader->mem, reader->end - reader->head + BUF_PAD);
+	break;
+    case BUF_RING:
+	munmap(reader->mem, (reader->end - reader->head + BUF_PAD) * 2);
+	break;
+    default:
+	break;
+    }
+}
+
+// Moves what is in use starting at head + shift to a new buffer of the
+// given size.
+static bool
+buf_resize(Reader reader, size_t shift, size_t size) {
+    char	*old = reader->head + shift;
+    char	*buf;
+    int		kind;
+
+    if (NULL == (buf = buf_alloc(&size, &kind))) {
+	return false;
+    }
+    memcpy(buf, old, reader->read_end - old);
+    buf_free(reader);
+    reader->mem = buf;
+    reader->head = buf;
+    reader->free_head = kind;
+    reader->end = buf + size - BUF_PAD;
+    reader->tail = buf + (reader->tail - old);
+    reader->read_end = buf + (reader->read_end - old);
+    if (0 != reader->pro) {
+	reader->pro = buf + (reader->pro - old);
+    }
+    if (0 != reader->start) {
+	reader->start = buf + (reader->start - old);
+    }
+    reader->full_reads = 0;
+    reader->small_reads = 0;
+
+    return true;
+}
+
+// Dropping bytes from the front of a ring only moves head and end. Once head
+// is in the second mapping everything is moved back by the ring size to the
+// same bytes in the first.
+static void
+ring_shift(Reader reader, size_t shift) {
+    size_t	size = reader->end - reader->head + BUF_PAD;
+
+    reader->head += shift;
+    reader->end += shift;
+    if (reader->mem + size <= reader->head) {
+	reader->head -= size;
+	reader->end -= size;
+	reader->tail -= size;
+	reader->read_end -= size;
+	if (0 != reader->pro) {
+	    reader->pro -= size;
+	}
+	if (0 != reader->start) {
+	    reader->start -= size;
+	}
+    }
+}
+
+// Readers that read from a source start with a buffer of ojc_read_buf_size.
+static void
+ojc_reader_init_buf(Reader reader) {
+    ojc_reader_init(reader);
+    if (sizeof(reader->base) < ojc_read_buf_size || ojc_read_ring) {
+	if (buf_resize(reader, 0, ojc_read_buf_size)) {
+	    *reader->head = '\0';
+	    reader->min_size = reader->end - reader->head + BUF_PAD;
+	}
+    }
+}
+
+void
+ojc_reader_cleanup(Reader reader) {
+    if (BUF_BASE != reader->free_head && 0 != reader->head) {
+	buf_free(reader);
+	reader->head = 0;
+	reader->free_head = BUF_BASE;
+    }
+    if (0 <= reader->notify) {
+	close(reader->notify);
+	reader->notify = -1;
+    }
+    free(reader->path);
+    reader->path = NULL;
+    if (NULL != reader->rotated) {
+	fclose(reader->rotated);
+	reader->rotated = NULL;
+    }
+    if (NULL != reader->uring) {
+	_ojc_uring_destroy(reader->uring);
+	reader->uring = NULL;
+    }
+    if (NULL != reader->ahead) {
+	_ojc_ahead_destroy(reader->ahead);
+	reader->ahead = NULL;
+    }
+    if (NULL != reader->lender) {
+	Lender	ld = reader->lender;
+
+	if (NULL != ld->chunk && NULL != ld->release) {
+	    ld->release(ld->src, ld->chunk);
+	}
+	free(ld->side);
+	free(ld);
+	reader->lender = NULL;
+    }
 }
 
 void
 ojc_reader_init_str(ojcErr err, Reader reader, const char *str) {
+    if (0 == str) {
+	snprintf(err->msg, sizeof(err->msg) - 1, "No source string provided during initialization.");
+	return;
+    }
+    ojc_reader_init_strn(err, reader, str, strlen(str));
+}
+
+// The string does not have to be terminated. Nothing past str + len is read.
+void
+ojc_reader_init_strn(ojcErr err, Reader reader, const char *str, size_t len) {
     if (0 == str) {
 	snprintf(err->msg, sizeof(err->msg) - 1, "No source string provided during initialization.");
 	return;
@@ -78,19 +341,44 @@ ojc_reader_init_str(ojcErr err, Reader reader, const char *str) {
     reader->str = str;
     reader->head = (char*)reader->str;
     reader->tail = reader->head;
-    reader->read_end = reader->head + strlen(str);
+    reader->read_end = reader->head + len;
     reader->eof = true;
 }
 
+// Source functions for the read-ahead thread.
+static ssize_t
+ahead_file_read(void *src, char *buf, size_t size) {
+    FILE	*file = (FILE*)src;
+    size_t	cnt = fread(buf, 1, size, file);
+
+    if (0 == cnt && ferror(file)) {
+	return -1;
+    }
+    return (ssize_t)cnt;
+}
+
+static ssize_t
+ahead_socket_read(void *src, char *buf, size_t size) {
+    return read(*(int*)src, buf, size);
+}
+
 void
 ojc_reader_init_stream(ojcErr err, Reader reader, FILE *file) {
     if (0 == file) {
 	snprintf(err->msg, sizeof(err->msg) - 1, "No source file provided during initialization.");
 	return;
     }
-    ojc_reader_init(reader);
+    ojc_reader_init_buf(reader);
     reader->read_func = read_from_file;
     reader->file = file;
+    // Anything the FILE has buffered would be skipped so io_uring is only
+    // used for files that can be synced back to the read position.
+    if (ojc_io_uring && 0 == fflush(file) && 0 <= lseek(fileno(file), 0, SEEK_CUR) &&
+	NULL != (reader->uring = _ojc_uring_create(fileno(file)))) {
+	reader->read_func = read_from_uring;
+    } else if (ojc_read_ahead && NULL != (reader->ahead = _ojc_ahead_create(ahead_file_read, file, true))) {
+	reader->read_func = read_from_ahead;
+    }
 }
 
 void
@@ -99,9 +387,29 @@ ojc_reader_init_follow(ojcErr err, Reader reader, FILE *file) {
 	snprintf(err->msg, sizeof(err->msg) - 1, "No source file provided during initialization.");
 	return;
     }
-    ojc_reader_init(reader);
+    ojc_reader_init_buf(reader);
     reader->read_func = read_from_follow;
     reader->file = file;
+#ifdef __linux__
+    {
+	char	link[64];
+	char	path[1024];
+	ssize_t	len;
+
+	snprintf(link, sizeof(link), "/proc/self/fd/%d", fileno(file));
+	if (0 < (len = readlink(link, path, sizeof(path) - 1))) {
+	    path[len] = '\0';
+	    reader->path = strdup(path);
+	}
+	if (0 <= (reader->notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC))) {
+	    reader->watch = inotify_add_watch(reader->notify, link, IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF | IN_ATTRIB);
+	    if (0 > reader->watch) {
+		close(reader->notify);
+		reader->notify = -1;
+	    }
+	}
+    }
+#endif
 }
 
 void
@@ -110,23 +418,195 @@ ojc_reader_init_socket(ojcErr err, Reader reader, int socket) {
 	snprintf(err->msg, sizeof(err->msg) - 1, "Invalid socket provided during initialization.");
 	return;
     }
-    ojc_reader_init(reader);
+    ojc_reader_init_buf(reader);
     reader->read_func = read_from_socket;
     reader->socket = socket;
+    if (ojc_io_uring && NULL != (reader->uring = _ojc_uring_create(socket))) {
+	reader->read_func = read_from_uring;
+    } else if (ojc_read_ahead && NULL != (reader->ahead = _ojc_ahead_create(ahead_socket_read, &reader->socket, true))) {
+	reader->read_func = read_from_ahead;
+    }
 }
 
 void
 ojc_reader_init_func(ojcErr err, Reader reader, void *src, ssize_t (*rf)(void *src, char *buf, size_t size)) {
-    ojc_reader_init(reader);
+    ojc_reader_init_buf(reader);
     reader->read_func = read_from_func;
     reader->src = src;
     reader->rf = rf;
+    // The function is not canceled since it might hold locks of its own.
+    if (ojc_read_ahead && NULL != (reader->ahead = _ojc_ahead_create(rf, src, false))) {
+	reader->read_func = read_from_ahead;
+    }
+}
+
+void
+ojc_reader_init_lender(ojcErr err, Reader reader, void *src, ojcLendFunc lend, ojcReleaseFunc release) {
+    Lender	ld;
+
+    if (NULL == lend) {
+	snprintf(err->msg, sizeof(err->msg) - 1, "No lend function provided during initialization.");
+	err->code = OJC_ARG_ERR;
+	return;
+    }
+    if (NULL == (ld = (Lender)calloc(1, sizeof(struct _Lender))) ||
+	NULL == (ld->side = (char*)malloc(sizeof(reader->base)))) {
+	free(ld);
+	err->code = OJC_MEMORY_ERR;
+	snprintf(err->msg, sizeof(err->msg) - 1, "Failed to allocate a lender.");
+	return;
+    }
+    ojc_reader_init(reader);
+    reader->read_func = read_from_lender;
+    ld->src = src;
+    ld->lend = lend;
+    ld->release = release;
+    ld->size = sizeof(reader->base);
+    reader->lender = ld;
+}
+
+// Makes sure the side buffer can hold size bytes and a terminator.
+static bool
+lender_reserve(Lender ld, Reader reader, size_t size) {
+    char	*side;
+
+    if (size + BUF_PAD <= ld->size) {
+	return true;
+    }
+    while (ld->size < size + BUF_PAD) {
+	ld->size *= 2;
+    }
+    if (NULL == (side = (char*)malloc(ld->size))) {
+	return false;
+    }
+    // Only what is in the side buffer needs to move with it.
+    if (ld->side <= reader->head && reader->head < ld->side + ld->size) {
+	memcpy(side, reader->head, reader->read_end - reader->head);
+	reader->tail = side + (reader->tail - reader->head);
+	reader->read_end = side + (reader->read_end - reader->head);
+	if (0 != reader->pro) {
+	    reader->pro = side + (reader->pro - reader->head);
+	}
+	if (0 != reader->start) {
+	    reader->start = side + (reader->start - reader->head);
+	}
+	reader->head = side;
+    }
+    free(ld->side);
+    ld->side = side;
+
+    return true;
+}
+
+// Releases the current chunk and borrows the next one. Returns false at the
+// end or on error.
+static bool
+lender_next(ojcErr err, Lender ld) {
+    const char	*chunk = NULL;
+    ssize_t	len;
+
+    if (NULL != ld->chunk && NULL != ld->release) {
+	ld->release(ld->src, ld->chunk);
+    }
+    ld->chunk = NULL;
+    ld->len = 0;
+    ld->pos = 0;
+    if (0 > (len = ld->lend(ld->src, &chunk))) {
+	snprintf(err->msg, sizeof(err->msg) - 1, "Error while borrowing from user provided lend function.");
+	return false;
+    }
+    if (0 == len || NULL == chunk) {
+	return false;
+    }
+    ld->chunk = chunk;
+    ld->len = (size_t)len;
+
+    return true;
+}
+
+// Called with tail at read_end. Anything from pro on is kept in the side
+// buffer, otherwise the next unread bytes of a chunk are read in place.
+static bool
+lender_read(ojcErr err, Reader reader) {
+    Lender	ld = reader->lender;
+    bool	in_side = (reader->head == ld->side);
+    size_t	keep;
+    size_t	cnt;
+
+    if (0 == reader->pro) {
+	ojc_reader_drop(reader, reader->read_end - reader->head);
+	if (!in_side || ld->len <= ld->pos) {
+	    if (!in_side) {
+		ld->pos = ld->len;
+	    }
+	    // Point at the empty side buffer so nothing refers to a released
+	    // chunk.
+	    reader->head = ld->side;
+	    reader->tail = reader->head;
+	    reader->read_end = reader->head;
+	    *reader->read_end = '\0';
+	    if (!lender_next(err, ld)) {
+		return true;
+	    }
+	}
+	reader->head = (char*)ld->chunk + ld->pos;
+	reader->tail = reader->head;
+	reader->read_end = (char*)ld->chunk + ld->len;
+	ld->pos = ld->len;
+
+	return false;
+    }
+    // Move the kept bytes to the front of the side buffer.
+    keep = reader->read_end - reader->pro;
+    ojc_reader_drop(reader, reader->pro - reader->head);
+    if (in_side) {
+	memmove(ld->side, reader->pro, keep);
+    } else {
+	if (!lender_reserve(ld, reader, keep)) {
+	    err->code = OJC_MEMORY_ERR;
+	    snprintf(err->msg, sizeof(err->msg) - 1, "Failed to allocate a %lu byte side buffer.", (unsigned long)ld->size);
+	    return true;
+	}
+	memcpy(ld->side, reader->pro, keep);
+	ld->pos = ld->len;
+    }
+    if (0 != reader->start) {
+	reader->start = ld->side + (reader->start - reader->pro);
+    }
+    reader->pro = ld->side;
+    reader->head = ld->side;
+    reader->tail = reader->head + keep;
+    reader->read_end = reader->tail;
+    *reader->read_end = '\0';
+    if (ld->len <= ld->pos && !lender_next(err, ld)) {
+	return true;
+    }
+    // Copy at least as much as is kept so a long token is copied a number of
+    // times proportional to its length.
+    cnt = keep < LEND_STEP ? LEND_STEP : keep;
+    if (ld->len - ld->pos < cnt) {
+	cnt = ld->len - ld->pos;
+    }
+    if (!lender_reserve(ld, reader, keep + cnt)) {
+	err->code = OJC_MEMORY_ERR;
+	snprintf(err->msg, sizeof(err->msg) - 1, "Failed to allocate a %lu byte side buffer.", (unsigned long)ld->size);
+	return true;
+    }
+    memcpy(reader->read_end, ld->chunk + ld->pos, cnt);
+    ld->pos += cnt;
+    reader->read_end += cnt;
+    *reader->read_end = '\0';
+
+    return false;
 }
 
 // returns true if EOF
 bool
 ojc_reader_read(ojcErr err, Reader reader) {
     size_t	shift = 0;
+    size_t	size;
+    size_t	max;
+    size_t	cnt;
     
     if (0 == reader->read_func) {
 	snprintf(err->msg, sizeof(err->msg) - 1, "Not initialized.");
@@ -135,33 +615,34 @@ ojc_reader_read(ojcErr err, Reader reader) {
     if (reader->eof) {
 	return true;
     }
-    // if there is not much room to read into, shift or realloc a larger buffer.
-    if (reader->head < reader->tail && 4096 > reader->end - reader->tail) {
+    if (NULL != reader->lender) {
+	return lender_read(err, reader);
+    }
+    size = reader->end - reader->head + BUF_PAD;
+    // If there is not much room to read into, shift or move to a buffer of a
+    // different size.
+    if (reader->head < reader->tail && size / 2 > (size_t)(reader->end - reader->tail)) {
 	if (0 == reader->pro) {
 	    shift = reader->tail - reader->head;
-	} else {
+	} else if (reader->head < reader->pro) {
 	    shift = reader->pro - reader->head - 1; // leave one character so we can backup one
 	}
-	if (0 >= shift) { /* no space left so allocate more */
-	    char	*old = reader->head;
-	    size_t	size = reader->end - reader->head + BUF_PAD;
-	
-	    if (reader->head == reader->base) {
-		reader->head = (char*)malloc(size * 2);
-		memcpy(reader->head, old, size);
-	    } else {
-		reader->head = (char*)realloc(reader->head, size * 2);
-	    }
-	    reader->free_head = 1;
-	    reader->end = reader->head + size * 2 - BUF_PAD;
-	    reader->tail = reader->head + (reader->tail - old);
-	    reader->read_end = reader->head + (reader->read_end - old);
-	    if (0 != reader->pro) {
-		reader->pro = reader->head + (reader->pro - old);
-	    }
-	    if (0 != reader->start) {
-		reader->start = reader->head + (reader->start - old);
+	if (0 < shift) {
+	    ojc_reader_drop(reader, shift);
+	}
+	if (0 >= shift) { // the current token fills the buffer so a bigger one is needed
+	    if (!buf_resize(reader, 0, size * 2)) {
+		err->code = OJC_MEMORY_ERR;
+		snprintf(err->msg, sizeof(err->msg) - 1, "Failed to allocate a %lu byte read buffer.", (unsigned long)size * 2);
+		return true;
 	    }
+	} else if (GROW_READS <= reader->full_reads && size * 2 <= ojc_read_buf_max &&
+		   buf_resize(reader, shift, size * 2)) {
+	} else if (SHRINK_READS <= reader->small_reads && reader->min_size < size && BUF_RING != reader->free_head &&
+		   (size_t)(reader->read_end - reader->head - shift) < size / 4 &&
+		   buf_resize(reader, shift, reader->min_size < size / 2 ? size / 2 : reader->min_size)) {
+	} else if (BUF_RING == reader->free_head) {
+	    ring_shift(reader, shift);
 	} else {
 	    memmove(reader->head, reader->head + shift, reader->read_end - (reader->head + shift));
 	    reader->tail -= shift;
@@ -174,12 +655,56 @@ ojc_reader_read(ojcErr err, Reader reader) {
 	    }
 	}
     }
+    max = reader->end - reader->tail;
     reader->eof = reader->read_func(err, reader);
     *reader->read_end = '\0';
-
+    // Track how much of the buffer reads use to decide when to resize.
+    cnt = reader->read_end - reader->tail;
+    size = reader->end - reader->head + BUF_PAD;
+    if (cnt == max) {
+	reader->full_reads++;
+	reader->small_reads = 0;
+    } else if (cnt < size / 4) {
+	reader->small_reads++;
+	reader->full_reads = 0;
+    } else {
+	reader->full_reads = 0;
+	reader->small_reads = 0;
+    }
     return reader->eof;
 }
 
+// Counts the lines in the cnt bytes at head before they are dropped from the
+// buffer.
+void
+ojc_reader_drop(Reader reader, size_t cnt) {
+    const char	*last = NULL;
+
+    reader->line += simd_count_lines(reader->head, reader->head + cnt, &last);
+    if (NULL == last) {
+	reader->col += (int)cnt;
+    } else {
+	reader->col = (int)(reader->head + cnt - last);
+    }
+    reader->pos += cnt;
+}
+
+// Returns the offset of tail from the start of the input and sets the line
+// and the column of the last byte read.
+size_t
+ojc_reader_position(Reader reader, int *linep, int *colp) {
+    const char	*last = NULL;
+    int		line = reader->line + simd_count_lines(reader->head, reader->tail, &last);
+
+    if (NULL != linep) {
+	*linep = line;
+    }
+    if (NULL != colp) {
+	*colp = (NULL == last) ? reader->col + (int)(reader->tail - reader->head) : (int)(reader->tail - last);
+    }
+    return reader->pos + (reader->tail - reader->head);
+}
+
 static bool
 read_from_file(ojcErr err, Reader reader) {
     ssize_t	cnt;
@@ -199,6 +724,70 @@ read_from_file(ojcErr err, Reader reader) {
     return eof;
 }
 
+// Starts over at the top of a truncated file and opens the path again if the
+// file was rotated. The caller's FILE is left alone. Returns true if the file
+// changed.
+static bool
+follow_check(ojcErr err, Reader reader) {
+    struct stat	fst;
+    struct stat	pst;
+    off_t	pos;
+    FILE	*f;
+
+    if (0 != fstat(fileno(reader->file), &fst)) {
+	return false;
+    }
+    if (0 <= (pos = ftello(reader->file)) && fst.st_size < pos) {
+	fseeko(reader->file, 0, SEEK_SET);
+	return true;
+    }
+    if (NULL == reader->path || 0 != stat(reader->path, &pst) ||
+	(pst.st_ino == fst.st_ino && pst.st_dev == fst.st_dev)) {
+	return false;
+    }
+    if (NULL == (f = fopen(reader->path, "r"))) {
+	snprintf(err->msg, sizeof(err->msg) - 1, "Failed to reopen %s. %s.", reader->path, strerror(errno));
+	err->code = OJC_ARG_ERR;
+	return true;
+    }
+    if (NULL != reader->rotated) {
+	fclose(reader->rotated);
+    }
+    reader->rotated = f;
+    reader->file = f;
+#ifdef __linux__
+    if (0 <= reader->notify) {
+	inotify_rm_watch(reader->notify, reader->watch);
+	reader->watch = inotify_add_watch(reader->notify, reader->path, IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF | IN_ATTRIB);
+    }
+#endif
+    return true;
+}
+
+// Waits for the followed file to change. Returns false on error.
+static bool
+follow_wait(ojcErr err, Reader reader) {
+    if (follow_check(err, reader)) {
+	return OJC_OK == err->code;
+    }
+#ifdef __linux__
+    if (0 <= reader->notify) {
+	struct pollfd	pfd = { .fd = reader->notify, .events = POLLIN };
+	char		buf[1024];
+
+	if (0 < poll(&pfd, 1, FOLLOW_NOTIFY_MSECS)) {
+	    // Only the wake up matters, not the events.
+	    while (0 < read(reader->notify, buf, sizeof(buf))) {
+	    }
+	}
+	return true;
+    }
+#endif
+    usleep(FOLLOW_POLL_USECS);
+
+    return true;
+}
+
 static bool
 read_from_follow(ojcErr err, Reader reader) {
     ssize_t	cnt = 0;
@@ -212,9 +801,8 @@ read_from_follow(ojcErr err, Reader reader) {
 		return true;
 	    }
 	    clearerr(reader->file);
-	    if (0 == cnt) {
-		// TBD is there a better way to detect a change in the file?
-		usleep(100000);
+	    if (0 == cnt && !follow_wait(err, reader)) {
+		return true;
 	    }
 	}
     }
@@ -238,6 +826,40 @@ read_from_socket(ojcErr err, Reader reader) {
     return (0 == cnt);
 }
 
+static bool
+read_from_uring(ojcErr err, Reader reader) {
+    ssize_t	cnt;
+
+    cnt = _ojc_uring_read(reader->uring, reader->tail, reader->end - reader->tail);
+    if (cnt < 0) {
+	snprintf(err->msg, sizeof(err->msg) - 1, "Error while reading with io_uring. %s.", strerror(errno));
+	return true;
+    }
+    reader->read_end = reader->tail + cnt;
+
+    return (0 == cnt);
+}
+
+static bool
+read_from_ahead(ojcErr err, Reader reader) {
+    ssize_t	cnt;
+
+    cnt = _ojc_ahead_read(reader->ahead, reader->tail, reader->end - reader->tail);
+    if (cnt < 0) {
+	snprintf(err->msg, sizeof(err->msg) - 1, "Error while reading ahead. %s.", strerror(errno));
+	return true;
+    }
+    reader->read_end = reader->tail + cnt;
+
+    return (0 == cnt);
+}
+
+// Lent chunks are read by lender_read() instead of into the buffer.
+static bool
+read_from_lender(ojcErr err, Reader reader) {
+    return true;
+}
+
 // This is only called when the end of the string is reached so just return eof (true).
 static bool
 read_from_str(ojcErr err, Reader reader) {
@@ -33,17 +33,32 @@
 
 #include <stdlib.h>
 
+#include "simd.h"
+
+// Where the reader buffer came from, kept in free_head.
+#define BUF_BASE	0
+#define BUF_MALLOC	1
+#define BUF_MAP		2
+#define BUF_RING	3
+
 typedef struct _Reader {
     char	base[0x00001000];
+    char	*mem;		// start of an allocated buffer, a ring moves head past it
     char	*head;
     char	*end;
     char	*tail;
     char	*read_end;	// one past last character read
     char	*pro;		// protection start, buffer can not slide past this point
     char	*start;		// start of current string being read
-    int		line;
-    int		col;
-    int		free_head;
+    // Line and column are only worked out when asked for. These are for the
+    // bytes already dropped from the front of the buffer.
+    int		line;		// line at head
+    int		col;		// column of the last byte before head
+    size_t	pos;		// bytes dropped before head
+    int		free_head;	// BUF_BASE, BUF_MALLOC, BUF_MAP, or BUF_RING
+    size_t	min_size;	// starting size, the buffer does not shrink below it
+    int		full_reads;	// reads in a row that filled the buffer
+    int		small_reads;	// reads in a row that used less than a quarter of it
     bool	eof;
     bool	(*read_func)(ojcErr err, struct _Reader *reader); // return eof state
     union {
@@ -55,14 +70,78 @@ typedef struct _Reader {
 	    ssize_t	(*rf)(void *src, char *buf, size_t size);
 	};
     };
+    struct _Uring	*uring;		// io_uring source or NULL
+    struct _Ahead	*ahead;		// read-ahead thread or NULL
+    struct _Lender	*lender;	// lent chunk source or NULL
+    // Used when following a file.
+    char	*path;		// so a rotated file can be reopened
+    FILE	*rotated;	// opened by the reader after a rotation or NULL
+    int		notify;		// inotify descriptor or -1 to poll
+    int		watch;
 } *Reader;
 
 extern void	ojc_reader_init_str(ojcErr err, Reader reader, const char *str);
+extern void	ojc_reader_init_strn(ojcErr err, Reader reader, const char *str, size_t len);
 extern void	ojc_reader_init_stream(ojcErr err, Reader reader, FILE *file);
 extern void	ojc_reader_init_follow(ojcErr err, Reader reader, FILE *file);
 extern void	ojc_reader_init_socket(ojcErr err, Reader reader, int socket);
 extern void	ojc_reader_init_func(ojcErr err, Reader reader, void *src, ssize_t (*rf)(void *src, char *buf, size_t size));
+extern void	ojc_reader_init_lender(ojcErr err, Reader reader, void *src, ojcLendFunc lend, ojcReleaseFunc release);
 extern bool	ojc_reader_read(ojcErr err, Reader reader);
+extern void	ojc_reader_drop(Reader reader, size_t cnt);
+extern size_t	ojc_reader_position(Reader reader, int *linep, int *colp);
+extern void	ojc_reader_cleanup(Reader reader);
+
+/* Sets *ptrp and *lenp to the unread bytes in the buffer, reading more first
+ * if there are none. Returns false if there is nothing left to read. Nothing
+ * past the span may be looked at. A chunk lent by an ojcLendFunc and a string
+ * given with a length are read in place and need not be followed by a '\0'.
+ */
+static inline bool
+ojc_reader_span(ojcErr err, Reader reader, const char **ptrp, size_t *lenp) {
+    if (reader->read_end <= reader->tail) {
+	if (reader->eof) {
+	    return false;
+	}
+	reader->eof = ojc_reader_read(err, reader);
+	if (reader->read_end <= reader->tail) {
+	    return false;
+	}
+    }
+    *ptrp = reader->tail;
+    *lenp = reader->read_end - reader->tail;
+
+    return true;
+}
+
+/* Reads more after the bytes in the buffer while keeping the bytes from from
+ * on, which are moved to tail to be read again. Returns false if nothing more
+ * was read.
+ */
+static inline bool
+ojc_reader_refill(ojcErr err, Reader reader, const char *from) {
+    char	*pro = reader->pro;
+    size_t	keep = reader->read_end - from;
+    size_t	pro_keep = (0 == pro) ? 0 : (size_t)(reader->read_end - pro);
+    char	*read_end;
+
+    if (reader->eof) {
+	return false;
+    }
+    if (0 == pro || from < pro) {
+	reader->pro = (char*)from;
+    }
+    reader->tail = reader->read_end;
+    reader->eof = ojc_reader_read(err, reader);
+    read_end = reader->tail;
+    reader->tail = read_end - keep;
+    if (0 == pro) {
+	reader->pro = 0;
+    } else {
+	reader->pro = read_end - pro_keep;
+    }
+    return read_end < reader->read_end;
+}
 
 static inline char
 ojc_reader_get(ojcErr err, Reader reader) {
@@ -76,23 +155,12 @@ ojc_reader_get(ojcErr err, Reader reader) {
 	    return '\0';
 	}	    
     }
-    if ('\n' == *reader->tail) {
-	reader->line++;
-	reader->col = 0;
-    }
-    reader->col++;
-    
     return *reader->tail++;
 }
 
 static inline void
 ojc_reader_backup(Reader reader) {
     reader->tail--;
-    reader->col--;
-    if (0 >= reader->col) {
-	reader->line--;
-	// allow col to be negative since we never backup twice in a row
-    }
 }
 
 static inline void
@@ -106,6 +174,14 @@ ojc_reader_release(Reader reader) {
     reader->pro = 0;
 }
 
+/* Moves past the white space already in the buffer a block at a time. Stops
+ * at the end of the buffer without reading more.
+ */
+static inline void
+ojc_reader_skip_white(Reader reader) {
+    reader->tail = (char*)simd_skip_white(reader->tail, reader->read_end);
+}
+
 /* Starts by reading a character so it is safe to use with an empty or
  * compacted buffer.
  */
@@ -120,6 +196,7 @@ ojc_reader_next_non_white(ojcErr err, Reader reader) {
 	case '\f':
 	case '\n':
 	case '\r':
+	    ojc_reader_skip_white(reader);
 	    break;
 	default:
 	    return c;
@@ -161,15 +238,6 @@ ojc_reader_expect(ojcErr err, Reader reader, const char *s) {
     return 0;
 }
 
-static inline void
-ojc_reader_cleanup(Reader reader) {
-    if (reader->free_head && 0 != reader->head) {
-	free(reader->head);
-	reader->head = 0;
-	reader->free_head = 0;
-    }
-}
-
 static inline int
 is_white(char c) {
     switch(c) {
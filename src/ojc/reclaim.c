@@ -0,0 +1,204 @@
+/* reclaim.c
+ * Copyright (c) 2014, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "reclaim.h"
+#include "val.h"
+
+// Values waiting to be destroyed are chained through their next pointers.
+// Roots are queued by callers. Parts are arrays holding some of the members
+// of a root that was split. Parts are taken first so a large tree is finished
+// before the next one is started. Reclaimer threads wait on ready until there
+// is work or they are told to stop. They only stop once both queues are
+// empty.
+static pthread_mutex_t	lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	ready = PTHREAD_COND_INITIALIZER;
+static struct _List	roots = LIST_INIT;
+static struct _List	parts = LIST_INIT;
+static pthread_t	*threads = NULL;
+static size_t		thread_cnt = 0;
+static bool		stop = false;
+
+static void
+enqueue(List q, ojcVal head, ojcVal tail) {
+    if (NULL == q->head) {
+	q->head = head;
+    } else {
+	q->tail->next = head;
+    }
+    q->tail = tail;
+}
+
+static ojcVal
+dequeue(List q) {
+    ojcVal	val = q->head;
+
+    if (NULL != val) {
+	if (NULL == (q->head = val->next)) {
+	    q->tail = NULL;
+	}
+	val->next = NULL;
+    }
+    return val;
+}
+
+// Moves all but the first of part_cnt parts of the members of val into new
+// arrays on the parts queue so other reclaimers can destroy them at the same
+// time.
+static void
+split(ojcVal val, size_t part_cnt) {
+    struct _List	arrays = LIST_INIT;
+    ojcVal		a;
+    ojcVal		m;
+    ojcVal		rest;
+    size_t		cnt = 0;
+    size_t		per;
+    size_t		i;
+
+    for (m = val->members.head; NULL != m; m = m->next) {
+	cnt++;
+    }
+    if (cnt < RECLAIM_SPLIT_MIN) {
+	return;
+    }
+    per = cnt / part_cnt;
+    // The first part, kept for val, also gets the remainder.
+    for (m = val->members.head, i = cnt - per * (part_cnt - 1); 1 < i; i--) {
+	m = m->next;
+    }
+    rest = m->next;
+    m->next = NULL;
+    val->members.tail = m;
+    for (; NULL != rest; rest = m->next) {
+	a = _ojc_val_create(OJC_ARRAY);
+	a->members.head = rest;
+	for (m = rest, i = per; 1 < i; i--) {
+	    m = m->next;
+	}
+	a->members.tail = m;
+	if (NULL == arrays.head) {
+	    arrays.head = a;
+	} else {
+	    arrays.tail->next = a;
+	}
+	arrays.tail = a;
+    }
+    for (a = arrays.head; NULL != a; a = a->next) {
+	a->members.tail->next = NULL;
+    }
+    pthread_mutex_lock(&lock);
+    enqueue(&parts, arrays.head, arrays.tail);
+    pthread_cond_broadcast(&ready);
+    pthread_mutex_unlock(&lock);
+}
+
+static void*
+work(void *arg) {
+    ojcVal	val;
+    size_t	part_cnt;
+
+    pthread_mutex_lock(&lock);
+    while (true) {
+	while (NULL == roots.head && NULL == parts.head && !stop) {
+	    pthread_cond_wait(&ready, &lock);
+	}
+	part_cnt = 0;
+	if (NULL == (val = dequeue(&parts))) {
+	    if (NULL == (val = dequeue(&roots))) {
+		break;
+	    }
+	    part_cnt = thread_cnt;
+	}
+	pthread_mutex_unlock(&lock);
+
+	if (1 < part_cnt && (OJC_ARRAY == val->type || OJC_OBJECT == val->type)) {
+	    split(val, part_cnt);
+	}
+	_ojc_destroy(val);
+	pthread_mutex_lock(&lock);
+    }
+    pthread_mutex_unlock(&lock);
+
+    return NULL;
+}
+
+void
+_ojc_reclaim(ojcVal val, size_t cnt) {
+    pthread_mutex_lock(&lock);
+    if (NULL == threads) {
+	if (0 == cnt) {
+	    cnt = 1;
+	}
+	if (NULL != (threads = (pthread_t*)malloc(sizeof(pthread_t) * cnt))) {
+	    for (thread_cnt = 0; thread_cnt < cnt; thread_cnt++) {
+		if (0 != pthread_create(&threads[thread_cnt], NULL, work, NULL)) {
+		    break;
+		}
+	    }
+	    if (0 == thread_cnt) {
+		free(threads);
+		threads = NULL;
+	    }
+	}
+    }
+    if (NULL == threads) {
+	pthread_mutex_unlock(&lock);
+	_ojc_destroy(val);
+	return;
+    }
+    val->next = NULL;
+    enqueue(&roots, val, val);
+    pthread_cond_signal(&ready);
+    pthread_mutex_unlock(&lock);
+}
+
+void
+_ojc_reclaim_cleanup() {
+    size_t	i;
+
+    pthread_mutex_lock(&lock);
+    if (NULL == threads) {
+	pthread_mutex_unlock(&lock);
+	return;
+    }
+    stop = true;
+    pthread_cond_broadcast(&ready);
+    pthread_mutex_unlock(&lock);
+
+    for (i = 0; i < thread_cnt; i++) {
+	pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    threads = NULL;
+    thread_cnt = 0;
+    stop = false;
+}
@@ -0,0 +1,320 @@
+/* simd.h
+ * Copyright (c) 2014, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __OJC_SIMD_H__
+#define __OJC_SIMD_H__
+
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define OJC_SIMD_AVX2	1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define OJC_SIMD_SSE2	1
+#endif
+
+#define SIMD_BLOCK	64
+
+#define CC_QUOTE	0x01
+#define CC_BSLASH	0x02
+#define CC_WHITE	0x04
+#define CC_OP		0x08
+#define CC_SLASH	0x10
+
+// One bit per byte of a 64 byte block with the low bit being the first
+// byte. Operators are the JSON structural characters { } [ ] : and ,.
+typedef struct _Block {
+    uint64_t	quote;
+    uint64_t	bslash;
+    uint64_t	white;
+    uint64_t	op;
+    uint64_t	slash;
+    uint64_t	ctrl;	// less than 0x20, includes some white space
+} *Block;
+
+extern const uint8_t	simd_char_class[256];
+
+#if defined(OJC_SIMD_AVX2)
+
+static inline uint64_t
+simd_mask64(__m256i lo, __m256i hi) {
+    return (uint64_t)(uint32_t)_mm256_movemask_epi8(lo) | ((uint64_t)(uint32_t)_mm256_movemask_epi8(hi) << 32);
+}
+
+static inline __m256i
+simd_eq(__m256i v, char c) {
+    return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+}
+
+static inline __m256i
+simd_ctrl(__m256i v) {
+    __m256i	c = _mm256_set1_epi8(0x1F);
+
+    return _mm256_cmpeq_epi8(_mm256_max_epu8(v, c), c);
+}
+
+static inline void
+simd_classify(const char *p, Block b) {
+    __m256i	lo = _mm256_loadu_si256((const __m256i*)p);
+    __m256i	hi = _mm256_loadu_si256((const __m256i*)(p + 32));
+    __m256i	lo20 = _mm256_or_si256(lo, _mm256_set1_epi8(0x20));
+    __m256i	hi20 = _mm256_or_si256(hi, _mm256_set1_epi8(0x20));
+
+    b->quote = simd_mask64(simd_eq(lo, '"'), simd_eq(hi, '"'));
+    b->ctrl = simd_mask64(simd_ctrl(lo), simd_ctrl(hi));
+    b->bslash = simd_mask64(simd_eq(lo, '\\'), simd_eq(hi, '\\'));
+    b->slash = simd_mask64(simd_eq(lo, '/'), simd_eq(hi, '/'));
+    // '[' and ']' are '{' and '}' with the 0x20 bit cleared.
+    b->op = simd_mask64(_mm256_or_si256(_mm256_or_si256(simd_eq(lo20, '{'), simd_eq(lo20, '}')),
+					_mm256_or_si256(simd_eq(lo, ':'), simd_eq(lo, ','))),
+			_mm256_or_si256(_mm256_or_si256(simd_eq(hi20, '{'), simd_eq(hi20, '}')),
+					_mm256_or_si256(simd_eq(hi, ':'), simd_eq(hi, ','))));
+    b->white = simd_mask64(_mm256_or_si256(_mm256_or_si256(simd_eq(lo, ' '), simd_eq(lo, '\n')),
+					   _mm256_or_si256(_mm256_or_si256(simd_eq(lo, '\t'), simd_eq(lo, '\r')),
+							   simd_eq(lo, '\f'))),
+			   _mm256_or_si256(_mm256_or_si256(simd_eq(hi, ' '), simd_eq(hi, '\n')),
+					   _mm256_or_si256(_mm256_or_si256(simd_eq(hi, '\t'), simd_eq(hi, '\r')),
+							   simd_eq(hi, '\f'))));
+}
+
+#elif defined(OJC_SIMD_SSE2)
+
+static inline __m128i
+simd_eq(__m128i v, char c) {
+    return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+}
+
+static inline __m128i
+simd_ctrl(__m128i v) {
+    __m128i	c = _mm_set1_epi8(0x1F);
+
+    return _mm_cmpeq_epi8(_mm_max_epu8(v, c), c);
+}
+
+static inline void
+simd_classify(const char *p, Block b) {
+    int	i;
+
+    b->quote = 0;
+    b->bslash = 0;
+    b->white = 0;
+    b->op = 0;
+    b->slash = 0;
+    b->ctrl = 0;
+    for (i = 0; i < SIMD_BLOCK; i += 16) {
+	__m128i	v = _mm_loadu_si128((const __m128i*)(p + i));
+	__m128i	v20 = _mm_or_si128(v, _mm_set1_epi8(0x20));
+	__m128i	op;
+	__m128i	white;
+
+	// '[' and ']' are '{' and '}' with the 0x20 bit cleared.
+	op = _mm_or_si128(_mm_or_si128(simd_eq(v20, '{'), simd_eq(v20, '}')),
+			  _mm_or_si128(simd_eq(v, ':'), simd_eq(v, ',')));
+	white = _mm_or_si128(_mm_or_si128(simd_eq(v, ' '), simd_eq(v, '\n')),
+			     _mm_or_si128(_mm_or_si128(simd_eq(v, '\t'), simd_eq(v, '\r')), simd_eq(v, '\f')));
+	b->quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(simd_eq(v, '"')) << i;
+	b->bslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(simd_eq(v, '\\')) << i;
+	b->slash |= (uint64_t)(uint16_t)_mm_movemask_epi8(simd_eq(v, '/')) << i;
+	b->op |= (uint64_t)(uint16_t)_mm_movemask_epi8(op) << i;
+	b->white |= (uint64_t)(uint16_t)_mm_movemask_epi8(white) << i;
+	b->ctrl |= (uint64_t)(uint16_t)_mm_movemask_epi8(simd_ctrl(v)) << i;
+    }
+}
+
+#else
+
+static inline void
+simd_classify(const char *p, Block b) {
+    const uint8_t	*u = (const uint8_t*)p;
+    uint64_t		bit = 1;
+    int			i;
+
+    b->quote = 0;
+    b->bslash = 0;
+    b->white = 0;
+    b->op = 0;
+    b->slash = 0;
+    b->ctrl = 0;
+    for (i = 0; i < SIMD_BLOCK; i++, bit <<= 1) {
+	if (u[i] < 0x20) {
+	    b->ctrl |= bit;
+	}
+	switch (simd_char_class[u[i]]) {
+	case CC_QUOTE:	b->quote |= bit;	break;
+	case CC_BSLASH:	b->bslash |= bit;	break;
+	case CC_WHITE:	b->white |= bit;	break;
+	case CC_OP:	b->op |= bit;		break;
+	case CC_SLASH:	b->slash |= bit;	break;
+	default:				break;
+	}
+    }
+}
+
+#endif
+
+// Returns the first character between p and end that is not white space or
+// end if there is none.
+static inline const char*
+simd_skip_white(const char *p, const char *end) {
+#if defined(OJC_SIMD_AVX2)
+    for (; p + 32 <= end; p += 32) {
+	__m256i		v = _mm256_loadu_si256((const __m256i*)p);
+	uint32_t	white = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(simd_eq(v, ' '), simd_eq(v, '\n')),
+									    _mm256_or_si256(_mm256_or_si256(simd_eq(v, '\t'), simd_eq(v, '\r')),
+											    simd_eq(v, '\f'))));
+
+	if (0xFFFFFFFFU != white) {
+	    return p + __builtin_ctz(~white);
+	}
+    }
+#elif defined(OJC_SIMD_SSE2)
+    for (; p + 16 <= end; p += 16) {
+	__m128i		v = _mm_loadu_si128((const __m128i*)p);
+	uint32_t	white = (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(simd_eq(v, ' '), simd_eq(v, '\n')),
+									 _mm_or_si128(_mm_or_si128(simd_eq(v, '\t'), simd_eq(v, '\r')),
+										      simd_eq(v, '\f'))));
+
+	if (0xFFFFU != white) {
+	    return p + __builtin_ctz(~white);
+	}
+    }
+#endif
+    for (; p < end; p++) {
+	if (CC_WHITE != simd_char_class[(uint8_t)*p]) {
+	    break;
+	}
+    }
+    return p;
+}
+
+// Returns the number of newlines between p and end and sets *lastp to the
+// last one. *lastp is left as is if there are none.
+static inline int
+simd_count_lines(const char *p, const char *end, const char **lastp) {
+    int	cnt = 0;
+
+#if defined(OJC_SIMD_AVX2)
+    for (; p + 32 <= end; p += 32) {
+	uint32_t	nl = (uint32_t)_mm256_movemask_epi8(simd_eq(_mm256_loadu_si256((const __m256i*)p), '\n'));
+
+	if (0 != nl) {
+	    cnt += __builtin_popcount(nl);
+	    *lastp = p + 31 - __builtin_clz(nl);
+	}
+    }
+#elif defined(OJC_SIMD_SSE2)
+    for (; p + 16 <= end; p += 16) {
+	uint32_t	nl = (uint32_t)_mm_movemask_epi8(simd_eq(_mm_loadu_si128((const __m128i*)p), '\n'));
+
+	if (0 != nl) {
+	    cnt += __builtin_popcount(nl);
+	    *lastp = p + 31 - __builtin_clz(nl);
+	}
+    }
+#endif
+    for (; p < end; p++) {
+	if ('\n' == *p) {
+	    cnt++;
+	    *lastp = p;
+	}
+    }
+    return cnt;
+}
+
+// Returns the first quote, backslash, or control character between p and end
+// or end if there is none.
+static inline const char*
+simd_scan_str(const char *p, const char *end) {
+#if defined(OJC_SIMD_AVX2)
+    for (; p + 32 <= end; p += 32) {
+	__m256i		v = _mm256_loadu_si256((const __m256i*)p);
+	uint32_t	m = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(simd_eq(v, '"'), simd_eq(v, '\\')),
+									simd_ctrl(v)));
+
+	if (0 != m) {
+	    return p + __builtin_ctz(m);
+	}
+    }
+#elif defined(OJC_SIMD_SSE2)
+    for (; p + 16 <= end; p += 16) {
+	__m128i		v = _mm_loadu_si128((const __m128i*)p);
+	uint32_t	m = (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(simd_eq(v, '"'), simd_eq(v, '\\')),
+								     simd_ctrl(v)));
+
+	if (0 != m) {
+	    return p + __builtin_ctz(m);
+	}
+    }
+#endif
+    for (; p < end; p++) {
+	if ('"' == *p || '\\' == *p || (uint8_t)*p < 0x20) {
+	    break;
+	}
+    }
+    return p;
+}
+
+// Each bit set in the result is set in m or has an odd number of bits set
+// below it in m. A set bit turns string mode on and the next one turns it off.
+static inline uint64_t
+simd_prefix_xor(uint64_t m) {
+    m ^= m << 1;
+    m ^= m << 2;
+    m ^= m << 4;
+    m ^= m << 8;
+    m ^= m << 16;
+    m ^= m << 32;
+
+    return m;
+}
+
+// Returns the characters escaped by a backslash. The carry is set if the last
+// character of the block is an unescaped backslash so the first character of
+// the next block is escaped.
+static inline uint64_t
+simd_escaped(uint64_t bslash, uint64_t *carry) {
+    const uint64_t	even = 0x5555555555555555ULL;
+    uint64_t		follows;
+    uint64_t		odd_starts;
+    uint64_t		seq;
+    uint64_t		escaped;
+
+    bslash &= ~*carry;
+    follows = (bslash << 1) | *carry;
+    odd_starts = bslash & ~even & ~follows;
+    seq = odd_starts + bslash;
+    *carry = (seq < bslash) ? 1 : 0;
+    escaped = (even ^ (seq << 1)) & follows;
+
+    return escaped;
+}
+
+#endif /* __OJC_SIMD_H__ */
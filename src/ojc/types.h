@@ -76,8 +76,11 @@ extern "C" {
     } *ojcErr;
 
     typedef struct _ojcVal	*ojcVal;
+    typedef struct _ojcParser	*ojcParser;
     typedef bool		(*ojcParseCallback)(ojcErr err, ojcVal val, void *ctx);
     typedef ssize_t		(*ojcReadFunc)(void *src, char *buf, size_t size);
+    typedef ssize_t		(*ojcLendFunc)(void *src, const char **bufp);
+    typedef void		(*ojcReleaseFunc)(void *src, const char *buf);
 
 #ifdef __cplusplus
 }
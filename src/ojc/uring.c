@@ -0,0 +1,409 @@
+/* uring.c
+ * Copyright (c) 2014, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "uring.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_URING	1
+#endif
+#endif
+
+#ifdef HAVE_URING
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#define RING_ENTRIES	8
+#define CANCEL_DATA	0xffffffffU
+
+typedef enum {
+    BUF_IDLE	= 0,
+    BUF_BUSY	= 1,
+    BUF_READY	= 2,
+} BufState;
+
+typedef struct _UringBuf {
+    char	*data;
+    off_t	off;	// file offset the read was made at
+    int		len;	// bytes read or -errno once ready
+    int		pos;	// bytes already copied out
+    BufState	state;
+} *UringBuf;
+
+struct _Uring {
+    int			ring;
+    int			fd;
+    bool		seekable;
+    bool		fixed;	// buffers are registered
+    bool		eof;	// no more reads are submitted
+    int			max_flight;
+    int			in_flight;
+    int			cur;	// buffer being copied out
+    int			sub;	// next buffer to read into
+    off_t		next_off;
+    struct _UringBuf	bufs[URING_BUF_CNT];
+    char		*mem;
+
+    void		*sq_map;
+    size_t		sq_map_size;
+    void		*cq_map;
+    size_t		cq_map_size;
+    struct io_uring_sqe	*sqes;
+    size_t		sqes_size;
+    _Atomic(uint32_t)	*sq_tail;
+    uint32_t		*sq_mask;
+    uint32_t		*sq_array;
+    _Atomic(uint32_t)	*cq_head;
+    _Atomic(uint32_t)	*cq_tail;
+    uint32_t		*cq_mask;
+    struct io_uring_cqe	*cqes;
+};
+
+static int
+ring_enter(Uring ur, unsigned int submit, unsigned int wait) {
+    int	rc;
+
+    do {
+	rc = (int)syscall(__NR_io_uring_enter, ur->ring, submit, wait, 0 < wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    } while (0 > rc && EINTR == errno);
+
+    return rc;
+}
+
+static struct io_uring_sqe*
+sqe_next(Uring ur) {
+    uint32_t		tail = atomic_load_explicit(ur->sq_tail, memory_order_relaxed);
+    uint32_t		idx = tail & *ur->sq_mask;
+    struct io_uring_sqe	*sqe = &ur->sqes[idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    ur->sq_array[idx] = idx;
+
+    return sqe;
+}
+
+static void
+sqe_push(Uring ur) {
+    uint32_t	tail = atomic_load_explicit(ur->sq_tail, memory_order_relaxed);
+
+    atomic_store_explicit(ur->sq_tail, tail + 1, memory_order_release);
+}
+
+static void
+submit(Uring ur, int i) {
+    UringBuf		b = &ur->bufs[i];
+    struct io_uring_sqe	*sqe = sqe_next(ur);
+
+    sqe->opcode = ur->fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = ur->fd;
+    sqe->addr = (uint64_t)(uintptr_t)b->data;
+    sqe->len = URING_BUF_SIZE;
+    // An offset of -1 reads from the current position of a socket or pipe.
+    sqe->off = ur->seekable ? (uint64_t)ur->next_off : (uint64_t)-1;
+    sqe->buf_index = (uint16_t)i;
+    sqe->user_data = (uint64_t)i;
+    sqe_push(ur);
+
+    b->off = ur->next_off;
+    b->pos = 0;
+    b->state = BUF_BUSY;
+    ur->in_flight++;
+    if (ur->seekable) {
+	ur->next_off += URING_BUF_SIZE;
+    }
+}
+
+// Starts reads into the idle buffers that follow the last one read into.
+static void
+fill(Uring ur) {
+    int	cnt = 0;
+
+    while (!ur->eof && ur->in_flight < ur->max_flight && BUF_IDLE == ur->bufs[ur->sub].state) {
+	submit(ur, ur->sub);
+	ur->sub = (ur->sub + 1) % URING_BUF_CNT;
+	cnt++;
+    }
+    if (0 < cnt && 0 > ring_enter(ur, cnt, 0)) {
+	// Nothing was submitted so act as if the reads failed.
+	int	err = errno;
+	int	i;
+
+	for (i = 0; i < URING_BUF_CNT; i++) {
+	    if (BUF_BUSY == ur->bufs[i].state) {
+		ur->bufs[i].state = BUF_READY;
+		ur->bufs[i].len = -err;
+	    }
+	}
+	ur->in_flight = 0;
+	ur->eof = true;
+    }
+}
+
+static void
+harvest(Uring ur) {
+    uint32_t	head = atomic_load_explicit(ur->cq_head, memory_order_relaxed);
+    uint32_t	tail = atomic_load_explicit(ur->cq_tail, memory_order_acquire);
+
+    for (; head != tail; head++) {
+	struct io_uring_cqe	*cqe = &ur->cqes[head & *ur->cq_mask];
+	UringBuf		b;
+
+	if (CANCEL_DATA == cqe->user_data) {
+	    continue;
+	}
+	b = &ur->bufs[cqe->user_data];
+	b->len = cqe->res;
+	b->state = BUF_READY;
+	ur->in_flight--;
+    }
+    atomic_store_explicit(ur->cq_head, head, memory_order_release);
+}
+
+static bool
+ring_map(Uring ur, struct io_uring_params *p) {
+    ur->sq_map_size = p->sq_off.array + p->sq_entries * sizeof(uint32_t);
+    ur->cq_map_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+    if (0 != (IORING_FEAT_SINGLE_MMAP & p->features)) {
+	if (ur->sq_map_size < ur->cq_map_size) {
+	    ur->sq_map_size = ur->cq_map_size;
+	}
+	ur->cq_map_size = 0;
+    }
+    ur->sq_map = mmap(NULL, ur->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ur->ring, IORING_OFF_SQ_RING);
+    if (MAP_FAILED == ur->sq_map) {
+	ur->sq_map = NULL;
+	return false;
+    }
+    if (0 == ur->cq_map_size) {
+	ur->cq_map = ur->sq_map;
+    } else {
+	ur->cq_map = mmap(NULL, ur->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ur->ring, IORING_OFF_CQ_RING);
+	if (MAP_FAILED == ur->cq_map) {
+	    ur->cq_map = NULL;
+	    return false;
+	}
+    }
+    ur->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+    ur->sqes = (struct io_uring_sqe*)mmap(NULL, ur->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+					  ur->ring, IORING_OFF_SQES);
+    if (MAP_FAILED == ur->sqes) {
+	ur->sqes = NULL;
+	return false;
+    }
+    ur->sq_tail = (_Atomic(uint32_t)*)((char*)ur->sq_map + p->sq_off.tail);
+    ur->sq_mask = (uint32_t*)((char*)ur->sq_map + p->sq_off.ring_mask);
+    ur->sq_array = (uint32_t*)((char*)ur->sq_map + p->sq_off.array);
+    ur->cq_head = (_Atomic(uint32_t)*)((char*)ur->cq_map + p->cq_off.head);
+    ur->cq_tail = (_Atomic(uint32_t)*)((char*)ur->cq_map + p->cq_off.tail);
+    ur->cq_mask = (uint32_t*)((char*)ur->cq_map + p->cq_off.ring_mask);
+    ur->cqes = (struct io_uring_cqe*)((char*)ur->cq_map + p->cq_off.cqes);
+
+    return true;
+}
+
+static void
+ring_free(Uring ur) {
+    if (NULL != ur->sqes) {
+	munmap(ur->sqes, ur->sqes_size);
+    }
+    if (NULL != ur->cq_map && ur->cq_map != ur->sq_map) {
+	munmap(ur->cq_map, ur->cq_map_size);
+    }
+    if (NULL != ur->sq_map) {
+	munmap(ur->sq_map, ur->sq_map_size);
+    }
+    if (0 <= ur->ring) {
+	close(ur->ring);
+    }
+    if (NULL != ur->mem) {
+	munmap(ur->mem, URING_BUF_CNT * URING_BUF_SIZE);
+    }
+    free(ur);
+}
+
+Uring
+_ojc_uring_create(int fd) {
+    struct io_uring_params	p;
+    struct iovec		iov[URING_BUF_CNT];
+    Uring			ur;
+    off_t			off;
+    int				i;
+
+    if (NULL == (ur = (Uring)calloc(1, sizeof(struct _Uring)))) {
+	return NULL;
+    }
+    ur->fd = fd;
+    memset(&p, 0, sizeof(p));
+    if (0 > (ur->ring = (int)syscall(__NR_io_uring_setup, RING_ENTRIES, &p)) || !ring_map(ur, &p) ||
+	// Only newer kernels read from the current position of sockets and pipes.
+	0 == (IORING_FEAT_RW_CUR_POS & p.features)) {
+	ring_free(ur);
+	return NULL;
+    }
+    ur->mem = (char*)mmap(NULL, URING_BUF_CNT * URING_BUF_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == ur->mem) {
+	ur->mem = NULL;
+	ring_free(ur);
+	return NULL;
+    }
+    for (i = 0; i < URING_BUF_CNT; i++) {
+	ur->bufs[i].data = ur->mem + i * URING_BUF_SIZE;
+	iov[i].iov_base = ur->bufs[i].data;
+	iov[i].iov_len = URING_BUF_SIZE;
+    }
+    // Registered buffers save mapping pages on each read but count against
+    // the locked memory limit so plain reads are used if that fails.
+    ur->fixed = (0 == syscall(__NR_io_uring_register, ur->ring, IORING_REGISTER_BUFFERS, iov, URING_BUF_CNT));
+    if (0 <= (off = lseek(fd, 0, SEEK_CUR))) {
+	ur->seekable = true;
+	ur->next_off = off;
+	ur->max_flight = URING_BUF_CNT;
+    } else {
+	ur->max_flight = 1;
+    }
+    fill(ur);
+
+    return ur;
+}
+
+ssize_t
+_ojc_uring_read(Uring ur, char *buf, size_t max) {
+    UringBuf	b;
+    size_t	cnt;
+
+    while (true) {
+	b = &ur->bufs[ur->cur];
+	switch (b->state) {
+	case BUF_READY:
+	    if (0 > b->len) {
+		errno = -b->len;
+		return -1;
+	    }
+	    if (b->pos < b->len) {
+		cnt = (size_t)(b->len - b->pos);
+		if (max < cnt) {
+		    cnt = max;
+		}
+		memcpy(buf, b->data + b->pos, cnt);
+		b->pos += (int)cnt;
+		// Start the next read as soon as a socket read completes.
+		fill(ur);
+		return (ssize_t)cnt;
+	    }
+	    // A file read that comes up short is at the end of the file.
+	    // Reads after it could see data appended later so they are
+	    // dropped.
+	    if (0 == b->len || (ur->seekable && b->len < URING_BUF_SIZE)) {
+		ur->eof = true;
+		return 0;
+	    }
+	    b->state = BUF_IDLE;
+	    ur->cur = (ur->cur + 1) % URING_BUF_CNT;
+	    fill(ur);
+	    break;
+	case BUF_BUSY:
+	    if (0 > ring_enter(ur, 0, 1)) {
+		return -1;
+	    }
+	    harvest(ur);
+	    break;
+	default:
+	    fill(ur);
+	    if (BUF_IDLE == b->state) {
+		return 0;
+	    }
+	    break;
+	}
+    }
+    return 0;
+}
+
+void
+_ojc_uring_destroy(Uring ur) {
+    int	cnt = 0;
+    int	i;
+
+    if (NULL == ur) {
+	return;
+    }
+    // A socket read might never complete so reads in flight are canceled
+    // and then waited on since the kernel could still write to the buffers.
+    for (i = 0; i < URING_BUF_CNT; i++) {
+	if (BUF_BUSY == ur->bufs[i].state) {
+	    struct io_uring_sqe	*sqe = sqe_next(ur);
+
+	    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	    sqe->fd = -1;
+	    sqe->addr = (uint64_t)i;
+	    sqe->user_data = CANCEL_DATA;
+	    sqe_push(ur);
+	    cnt++;
+	}
+    }
+    if (0 < cnt) {
+	ring_enter(ur, cnt, 0);
+    }
+    while (0 < ur->in_flight && 0 <= ring_enter(ur, 0, 1)) {
+	harvest(ur);
+    }
+    if (ur->seekable) {
+	lseek(ur->fd, ur->bufs[ur->cur].off + ur->bufs[ur->cur].pos, SEEK_SET);
+    }
+    ring_free(ur);
+}
+
+#else
+
+Uring
+_ojc_uring_create(int fd) {
+    return NULL;
+}
+
+ssize_t
+_ojc_uring_read(Uring ur, char *buf, size_t max) {
+    errno = ENOSYS;
+    return -1;
+}
+
+void
+_ojc_uring_destroy(Uring ur) {
+}
+
+#endif
@@ -0,0 +1,58 @@
+/* uring.h
+ * Copyright (c) 2014, Peter Ohler
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *  - Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ *  - Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ *  - Neither the name of Peter Ohler nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __OJC_URING_H__
+#define __OJC_URING_H__
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+// Reads are made into this many buffers of URING_BUF_SIZE so the kernel can
+// fill the next ones while the parser works on the current one.
+#define URING_BUF_CNT	4
+#define URING_BUF_SIZE	0x00010000
+
+typedef struct _Uring	*Uring;
+
+// Returns an io_uring source for fd or NULL if io_uring is not available in
+// which case the caller should read as before. Files are read ahead from the
+// current offset with all the buffers in flight. Sockets and pipes have one
+// read in flight at a time to keep the data in order.
+extern Uring	_ojc_uring_create(int fd);
+
+// Copies up to max bytes into buf. Returns 0 at the end of the data and -1
+// with errno set on error.
+extern ssize_t	_ojc_uring_read(Uring ur, char *buf, size_t max);
+
+// Waits for reads still in flight and frees the ring. A file is left at the
+// offset after the last byte read with _ojc_uring_read().
+extern void	_ojc_uring_destroy(Uring ur);
+
+#endif /* __OJC_URING_H__ */
@@ -28,35 +28,235 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "intern.h"
 #include "val.h"
 
-static struct _List	free_vals = LIST_INIT;
-static struct _MList	free_bstrs = LIST_INIT;
+// Freed values and Bstrs are kept in per-thread caches of magazines, each a
+// stack of up to MAG_SIZE items. A thread allocates from and frees to its
+// loaded magazine and swaps in its previous one when the loaded one runs
+// empty or full. Only then does it go to the depot to trade a whole magazine
+// so threads rarely touch shared memory. The depot is a fixed set of slots
+// taken with an atomic exchange and filled with a compare and swap so there
+// is no lock and no ABA problem. Items that do not fit go back to malloc.
+// When the depot has nothing to give a whole magazine of items is allocated.
+typedef struct _Mag {
+    int		cnt;
+    void	*items[MAG_SIZE];
+} *Mag;
+
+typedef struct _Slots {
+    _Atomic(Mag)	mags[DEPOT_SLOTS];
+    atomic_int		cnt;	// about how many slots are filled
+} *Slots;
+
+typedef struct _Depot {
+    struct _Slots	full;	// magazines with at least one item
+    struct _Slots	empty;
+} *Depot;
+
+typedef struct _Cache {
+    Mag		loaded;
+    Mag		prev;
+    int		hint;	// depot slot to start looking at
+} *Cache;
+
+typedef struct _ThreadCache {
+    struct _Cache	vals;
+    struct _Cache	bstrs;
+    bool		registered;
+} *ThreadCache;
+
+static struct _Depot		val_depot;
+static struct _Depot		bstr_depot;
+static __thread struct _ThreadCache	thread_cache;
+static pthread_key_t		cache_key;
+static pthread_once_t		cache_once = PTHREAD_ONCE_INIT;
+static atomic_uint		hint_seed = 0;
+
+// The count is checked first so an empty set of slots is not searched. It
+// can lag behind a put or take on another thread which at worst means a
+// magazine is missed or malloc is used.
+static Mag
+depot_take(Slots slots, int hint) {
+    Mag	m;
+    int	i;
+
+    if (atomic_load_explicit(&slots->cnt, memory_order_relaxed) <= 0) {
+	return NULL;
+    }
+    for (i = 0; i < DEPOT_SLOTS; i++, hint = (hint + 1) % DEPOT_SLOTS) {
+	if (NULL != atomic_load_explicit(&slots->mags[hint], memory_order_relaxed) &&
+	    NULL != (m = atomic_exchange(&slots->mags[hint], NULL))) {
+	    atomic_fetch_sub_explicit(&slots->cnt, 1, memory_order_relaxed);
+	    return m;
+	}
+    }
+    return NULL;
+}
 
-ojcVal
-_ojc_val_create(ojcValType type) {
-    ojcVal	val = NULL;
+static bool
+depot_put(Slots slots, int hint, Mag m) {
+    Mag	expect;
+    int	i;
 
-    // Carelessly check to see if a new val is needed. It doesn't matter if we
-    // get it wrong here.
-    if (NULL == free_vals.head || free_vals.head == free_vals.tail) {
-	val = (ojcVal)malloc(sizeof(struct _ojcVal));
-    } else {
-	// Looks like we need to lock it down for a moment using the atomic busy
-	// flag.
-	while (atomic_flag_test_and_set(&free_vals.busy)) {
+    if (DEPOT_SLOTS <= atomic_load_explicit(&slots->cnt, memory_order_relaxed)) {
+	return false;
+    }
+    for (i = 0; i < DEPOT_SLOTS; i++, hint = (hint + 1) % DEPOT_SLOTS) {
+	expect = NULL;
+	if (NULL == atomic_load_explicit(&slots->mags[hint], memory_order_relaxed) &&
+	    atomic_compare_exchange_strong(&slots->mags[hint], &expect, m)) {
+	    atomic_fetch_add_explicit(&slots->cnt, 1, memory_order_relaxed);
+	    return true;
 	}
-	if (NULL == free_vals.head || free_vals.head == free_vals.tail) {
-	    val = (ojcVal)malloc(sizeof(struct _ojcVal));
-	} else {
-	    val = free_vals.head;
-	    free_vals.head = free_vals.head->next;
+    }
+    return false;
+}
+
+static void
+mag_free(Mag m) {
+    if (NULL != m) {
+	while (0 < m->cnt) {
+	    free(m->items[--m->cnt]);
+	}
+	free(m);
+    }
+}
+
+// Hands a magazine to the depot or frees it and its items if there is no
+// room.
+static void
+mag_release(Depot d, Cache c, Mag m) {
+    if (NULL == m) {
+	return;
+    }
+    if (!depot_put(0 < m->cnt ? &d->full : &d->empty, c->hint, m)) {
+	mag_free(m);
+    }
+}
+
+static void
+cache_flush(void *arg) {
+    ThreadCache	tc = (ThreadCache)arg;
+
+    mag_release(&val_depot, &tc->vals, tc->vals.loaded);
+    mag_release(&val_depot, &tc->vals, tc->vals.prev);
+    mag_release(&bstr_depot, &tc->bstrs, tc->bstrs.loaded);
+    mag_release(&bstr_depot, &tc->bstrs, tc->bstrs.prev);
+    memset(tc, 0, sizeof(*tc));
+}
+
+static void
+cache_key_create() {
+    pthread_key_create(&cache_key, cache_flush);
+}
+
+// Registers the thread cache the first time it is used so it is returned to
+// the depot when the thread exits.
+static inline Cache
+cache_get(bool bstr) {
+    ThreadCache	tc = &thread_cache;
+
+    if (!tc->registered) {
+	pthread_once(&cache_once, cache_key_create);
+	pthread_setspecific(cache_key, tc);
+	tc->vals.hint = atomic_fetch_add(&hint_seed, 7) % DEPOT_SLOTS;
+	tc->bstrs.hint = tc->vals.hint;
+	tc->registered = true;
+    }
+    return bstr ? &tc->bstrs : &tc->vals;
+}
+
+// Fills the loaded magazine, which is empty, with newly allocated items and
+// returns one more so the depot is not searched again until they are used.
+// Each item is allocated on its own since each may be freed on its own.
+static void*
+cache_fill(Depot d, Cache c, size_t size) {
+    Mag		m = c->loaded;
+    void	*item;
+
+    if (NULL == m) {
+	if (NULL == (m = depot_take(&d->empty, c->hint)) && NULL == (m = (Mag)malloc(sizeof(struct _Mag)))) {
+	    return malloc(size);
 	}
-	atomic_flag_clear(&free_vals.busy);
+	m->cnt = 0;
+	c->loaded = m;
+    }
+    while (m->cnt < MAG_SIZE - 1 && NULL != (item = malloc(size))) {
+	m->items[m->cnt++] = item;
+    }
+    return malloc(size);
+}
+
+// Returns a cached or newly allocated item of size bytes.
+static inline void*
+cache_pop(Depot d, Cache c, size_t size) {
+    Mag	m = c->loaded;
+
+    if (NULL != m && 0 < m->cnt) {
+	return m->items[--m->cnt];
+    }
+    if (NULL != c->prev && 0 < c->prev->cnt) {
+	c->loaded = c->prev;
+	c->prev = m;
+	return c->loaded->items[--c->loaded->cnt];
     }
+    if (NULL == (m = depot_take(&d->full, c->hint))) {
+	return cache_fill(d, c, size);
+    }
+    mag_release(d, c, c->prev);
+    c->prev = c->loaded;
+    c->loaded = m;
+
+    return m->items[--m->cnt];
+}
+
+// Caches an item. Returns false if it could not be cached so the caller
+// should free it.
+static inline bool
+cache_push(Depot d, Cache c, void *item) {
+    Mag	m = c->loaded;
+
+    if (NULL != m && m->cnt < MAG_SIZE) {
+	m->items[m->cnt++] = item;
+	return true;
+    }
+    if (NULL != c->prev && c->prev->cnt < MAG_SIZE) {
+	c->loaded = c->prev;
+	c->prev = m;
+	c->loaded->items[c->loaded->cnt++] = item;
+	return true;
+    }
+    if (NULL == (m = depot_take(&d->empty, c->hint)) && NULL == (m = (Mag)malloc(sizeof(struct _Mag)))) {
+	return false;
+    }
+    m->cnt = 0;
+    mag_release(d, c, c->prev);
+    c->prev = c->loaded;
+    c->loaded = m;
+    m->items[m->cnt++] = item;
+
+    return true;
+}
+
+static inline ojcVal
+val_get(Cache c) {
+    return (ojcVal)cache_pop(&val_depot, c, sizeof(struct _ojcVal));
+}
+
+static inline Bstr
+bstr_get(Cache c) {
+    return (Bstr)cache_pop(&bstr_depot, c, sizeof(union _Bstr));
+}
+
+ojcVal
+_ojc_val_create(ojcValType type) {
+    ojcVal	val = val_get(cache_get(false));
+
     val->next = NULL;
     val->key_len = KEY_NONE;
     val->str_len = 0;
@@ -70,26 +270,12 @@ _ojc_val_create(ojcValType type) {
 
 void
 _ojc_val_create_batch(size_t cnt, List vals) {
+    Cache	c = cache_get(false);
     ojcVal	v;
 
-    if (free_vals.head != free_vals.tail) {
-	while (atomic_flag_test_and_set(&free_vals.busy)) {
-	}
-	if (free_vals.head != free_vals.tail) {
-	    ojcVal	prev = free_vals.head;
-
-	    vals->head = prev;
-	    for (v = prev; 0 < cnt && v != free_vals.tail; cnt--, v = v->next) {
-		prev = v;
-	    }
-	    free_vals.head = v;
-	    vals->tail = prev;
-	    vals->tail->next = 0;
-	}
-	atomic_flag_clear(&free_vals.busy);
-    }
     for (; 0 < cnt; cnt--) {
-	v = _ojc_val_create(OJC_NULL);
+	v = val_get(c);
+	v->next = NULL;
 	if (0 == vals->head) {
 	    vals->head = v;
 	} else {
@@ -101,20 +287,23 @@ _ojc_val_create_batch(size_t cnt, List vals) {
 
 static void
 free_key(ojcVal val, MList freed_bstrs) {
-    if (KEY_NONE != val->key_len) {
-	if ((int)sizeof(union _Bstr) <= val->key_len) {
-	    free(val->key.str);
-	} else if ((int)sizeof(val->key.ca) <= val->key_len) {
-	    if (0 == freed_bstrs->head) {
-		freed_bstrs->head = val->key.bstr;
-	    } else {
-		freed_bstrs->tail->next = val->key.bstr;
-	    }
-	    val->key.bstr->next = 0;
-	    freed_bstrs->tail = val->key.bstr;
+    switch (_ojc_key_kind(val)) {
+    case STR_PTR:
+	free(val->key.str);
+	break;
+    case STR_BLOCK:
+	if (0 == freed_bstrs->head) {
+	    freed_bstrs->head = val->key.bstr;
+	} else {
+	    freed_bstrs->tail->next = val->key.bstr;
 	}
-	val->key_len = KEY_NONE;
+	val->key.bstr->next = 0;
+	freed_bstrs->tail = val->key.bstr;
+	break;
+    default:
+	break;
     }
+    val->key_len = KEY_NONE;
 }
 
 void
@@ -122,24 +311,19 @@ _ojc_set_key(ojcVal val, const char *key, int klen) {
     struct _MList	freed_bstrs = { 0, 0 };
 
     free_key(val, &freed_bstrs);
-    while (atomic_flag_test_and_set(&free_bstrs.busy)) {
-    }
-    if (0 != freed_bstrs.head) {
-	if (0 == free_bstrs.head) {
-	    free_bstrs.head = freed_bstrs.head;
-	} else {
-	    free_bstrs.tail->next = freed_bstrs.head;
-	}
-	free_bstrs.tail = freed_bstrs.tail;
-    }
-    atomic_flag_clear(&free_bstrs.busy);
+    _ojc_bstr_return(&freed_bstrs);
 
     if (0 != key) {
-	if (0 >= klen) {
+	const char	*ikey;
+
+	if (0 > klen) {
 	    klen = strlen(key);
 	}
 	val->key_len = (uint16_t)klen;
-	if ((int)sizeof(union _Bstr) <= klen) {
+	if (ojc_intern_keys && NULL != (ikey = _ojc_intern(key, klen))) {
+	    val->key.str = (char*)ikey;
+	    val->key_len |= KEY_REF_FLAG | KEY_INTERN_FLAG;
+	} else if ((int)sizeof(union _Bstr) <= klen) {
 	    if ((int)KEY_BIG <= klen) {
 		val->key_len = KEY_BIG;
 	    }
@@ -165,9 +349,11 @@ _ojc_val_destroy(ojcVal val, List freed, MList freed_bstrs) {
     }
     free_key(val, freed_bstrs);
     if (OJC_STRING == val->type || OJC_NUMBER == val->type) {
-	if ((int)sizeof(union _Bstr) <= val->str_len) {
+	switch (_ojc_str_kind(val)) {
+	case STR_PTR:
 	    free(val->str.str);
-	} else if ((int)sizeof(val->str.ca) <= val->str_len) {
+	    break;
+	case STR_BLOCK:
 	    if (0 == freed_bstrs->head) {
 		freed_bstrs->head = val->str.bstr;
 	    } else {
@@ -175,6 +361,9 @@ _ojc_val_destroy(ojcVal val, List freed, MList freed_bstrs) {
 	    }
 	    val->str.bstr->next = 0;
 	    freed_bstrs->tail = val->str.bstr;
+	    break;
+	default: // STR_REF strings belong to the caller
+	    break;
 	}
     }
     if (OJC_ARRAY == val->type || OJC_OBJECT == val->type) {
@@ -205,27 +394,19 @@ _ojc_val_destroy(ojcVal val, List freed, MList freed_bstrs) {
 
 void
 _ojc_val_return(List freed, MList freed_bstrs) {
-    if (0 == freed->head) {
-	return;
-    }
-    while (atomic_flag_test_and_set(&free_vals.busy)) {
-    }
-    if (0 == free_vals.head) {
-	free_vals.head = freed->head;
-    } else {
-	free_vals.tail->next = freed->head;
-    }
-    free_vals.tail = freed->tail;
+    Cache	c = cache_get(false);
+    ojcVal	v;
+    ojcVal	next;
 
-    if (0 != freed_bstrs->head) {
-	if (0 == free_bstrs.head) {
-	    free_bstrs.head = freed_bstrs->head;
-	} else {
-	    free_bstrs.tail->next = freed_bstrs->head;
+    for (v = freed->head; NULL != v; v = next) {
+	next = v->next;
+	if (!cache_push(&val_depot, c, v)) {
+	    free(v);
 	}
-	free_bstrs.tail = freed_bstrs->tail;
     }
-    atomic_flag_clear(&free_vals.busy);
+    freed->head = NULL;
+    freed->tail = NULL;
+    _ojc_bstr_return(freed_bstrs);
 }
 
 int
@@ -242,21 +423,8 @@ _ojc_destroy(ojcVal val) {
 
 Bstr
 _ojc_bstr_create() {
-    Bstr	bstr;
+    Bstr	bstr = bstr_get(cache_get(true));
 
-    if (free_bstrs.head == free_bstrs.tail) {
-	bstr = (Bstr)malloc(sizeof(union _Bstr));
-    } else {
-	while (atomic_flag_test_and_set(&free_bstrs.busy)) {
-	}
-	if (free_bstrs.head == free_bstrs.tail) {
-	    bstr = (Bstr)malloc(sizeof(union _Bstr));
-	} else {
-	    bstr = free_bstrs.head;
-	    free_bstrs.head = free_bstrs.head->next;
-	}
-	atomic_flag_clear(&free_bstrs.busy);
-    }
     *bstr->ca = '\0';
 
     return bstr;
@@ -264,26 +432,11 @@ _ojc_bstr_create() {
 
 void
 _ojc_bstr_create_batch(size_t cnt, MList list) {
+    Cache	c = cache_get(true);
     Bstr	v;
 
-    if (free_bstrs.head != free_bstrs.tail) {
-	while (atomic_flag_test_and_set(&free_bstrs.busy)) {
-	}
-	if (free_bstrs.head != free_bstrs.tail) {
-	    Bstr	prev = free_bstrs.head;
-
-	    list->head = prev;
-	    for (v = prev; 0 < cnt && v != free_bstrs.tail; cnt--, v = v->next) {
-		prev = v;
-	    }
-	    free_bstrs.head = v;
-	    list->tail = prev;
-	    list->tail->next = 0;
-	}
-	atomic_flag_clear(&free_bstrs.busy);
-    }
     for (; 0 < cnt; cnt--) {
-	v = _ojc_bstr_create();
+	v = bstr_get(c);
 	v->next = 0;
 	if (0 == list->head) {
 	    list->head = v;
@@ -296,50 +449,46 @@ _ojc_bstr_create_batch(size_t cnt, MList list) {
 
 void
 _ojc_bstr_return(MList freed) {
-    if (0 == freed->head) {
-	return;
-    }
-    while (atomic_flag_test_and_set(&free_bstrs.busy)) {
-    }
-    if (0 == free_bstrs.head) {
-	free_bstrs.head = freed->head;
-    } else {
-	free_bstrs.tail->next = freed->head;
+    Cache	c = cache_get(true);
+    Bstr	b;
+    Bstr	next;
+
+    for (b = freed->head; NULL != b; b = next) {
+	next = b->next;
+	if (!cache_push(&bstr_depot, c, b)) {
+	    free(b);
+	}
     }
-    free_bstrs.tail = freed->tail;
-    atomic_flag_clear(&free_bstrs.busy);
+    freed->head = NULL;
+    freed->tail = NULL;
 }
 
-void
-_ojc_val_cleanup() {
-    ojcVal	v;
-    ojcVal	head;
-    Bstr	bhead;
-    Bstr	b;
+static void
+depot_cleanup(Depot d) {
+    Mag	m;
 
-    while (atomic_flag_test_and_set(&free_vals.busy)) {
+    while (NULL != (m = depot_take(&d->full, 0))) {
+	mag_free(m);
     }
-    head = free_vals.head;
-    free_vals.head = NULL;
-    free_vals.tail = NULL;
-    atomic_flag_clear(&free_vals.busy);
-    while (atomic_flag_test_and_set(&free_bstrs.busy)) {
-    }
-    bhead = free_bstrs.head;
-    free_bstrs.head = NULL;
-    free_bstrs.tail = NULL;
-    atomic_flag_clear(&free_bstrs.busy);
-
-    while (0 != head) {
-	v = head;
-	head = v->next;
-	free(v);
-    }
-
-    while (0 != bhead) {
-	b = bhead;
-	bhead = b->next;
-	free(b);
+    while (NULL != (m = depot_take(&d->empty, 0))) {
+	mag_free(m);
     }
 }
 
+// Frees what the calling thread has cached and everything in the depot.
+// Other threads keep their caches until they exit.
+void
+_ojc_val_cleanup() {
+    ThreadCache	tc = &thread_cache;
+
+    mag_free(tc->vals.loaded);
+    mag_free(tc->vals.prev);
+    mag_free(tc->bstrs.loaded);
+    mag_free(tc->bstrs.prev);
+    tc->vals.loaded = NULL;
+    tc->vals.prev = NULL;
+    tc->bstrs.loaded = NULL;
+    tc->bstrs.prev = NULL;
+    depot_cleanup(&val_depot);
+    depot_cleanup(&bstr_depot);
+}
@@ -33,6 +33,7 @@
 
 #include <stdint.h>
 #include <stdatomic.h>
+#include <string.h>
 
 #include "ojc.h"
 
@@ -40,12 +41,28 @@
 #define STR_PTR		'p'
 #define STR_ARRAY	'a'
 #define STR_BLOCK	'b'
+#define STR_REF		'r'
+#define STR_INTERN	'i'
 
-#define LIST_INIT	{ NULL, NULL, ATOMIC_FLAG_INIT }
+// Set in str_len or key_len when the string or key points into the caller's
+// buffer. Referenced strings are not owned by the value and are not
+// terminated.
+#define STR_REF_FLAG	0x80000000U
+#define KEY_REF_FLAG	0x00008000U
+// Set along with KEY_REF_FLAG when the key is in the intern table. Interned
+// keys are terminated and equal keys have the same pointer.
+#define KEY_INTERN_FLAG	0x00004000U
+
+#define LIST_INIT	{ NULL, NULL }
+
+// Items per magazine in the per-thread caches of freed values and Bstrs and
+// the number of magazines the shared depot holds for each.
+#define MAG_SIZE	256
+#define DEPOT_SLOTS	512
 
 #define KEY_NONE	((int)0x0000ffffU)
-#define KEY_BIG		((int)0x0000fffeU)
-#define STR_BIG		((int64_t)0x00000000ffffffffULL)
+#define KEY_BIG		((int)0x00007fffU)
+#define STR_BIG		((int64_t)0x000000007fffffffULL)
 
 typedef enum {
     NEXT_NONE		= 0,
@@ -77,16 +94,13 @@ union _Str {
 };
 
 typedef struct _List {
-    // pointer is volatile
-    struct _ojcVal	*volatile head;
-    struct _ojcVal	*volatile tail;
-    atomic_flag		busy;
+    struct _ojcVal	*head;
+    struct _ojcVal	*tail;
 } *List;
 
 typedef struct _MList {
-    union _Bstr	*volatile	head;
-    union _Bstr	*volatile	tail;
-    atomic_flag			busy;
+    union _Bstr	*head;
+    union _Bstr	*tail;
 } *MList;
 
 struct _ojcVal {
@@ -105,6 +119,93 @@ struct _ojcVal {
     uint8_t		expect; // ValNext
 };
 
+// Storage kind of a string, number, or word value.
+static inline int
+_ojc_str_kind(ojcVal val) {
+    if (0 != (STR_REF_FLAG & val->str_len)) {
+	return STR_REF;
+    }
+    if (sizeof(union _Bstr) <= val->str_len) {
+	return STR_PTR;
+    }
+    if (sizeof(val->str.ca) <= val->str_len) {
+	return STR_BLOCK;
+    }
+    return STR_ARRAY;
+}
+
+static inline const char*
+_ojc_str_ptr(ojcVal val) {
+    switch (_ojc_str_kind(val)) {
+    case STR_REF:
+    case STR_PTR:	return val->str.str;
+    case STR_BLOCK:	return val->str.bstr->ca;
+    default:		break;
+    }
+    return val->str.ca;
+}
+
+static inline int
+_ojc_str_len(ojcVal val) {
+    return (int)(val->str_len & ~STR_REF_FLAG);
+}
+
+// Borrowed strings end at the closing quote in the input. Strings parsed in
+// situ were terminated there.
+static inline bool
+_ojc_str_terminated(ojcVal val) {
+    return STR_REF != _ojc_str_kind(val) || '\0' == val->str.str[_ojc_str_len(val)];
+}
+
+static inline int
+_ojc_key_kind(ojcVal val) {
+    if (KEY_NONE == val->key_len) {
+	return STR_NONE;
+    }
+    if (0 != (KEY_REF_FLAG & val->key_len)) {
+	return (0 != (KEY_INTERN_FLAG & val->key_len)) ? STR_INTERN : STR_REF;
+    }
+    if ((int)sizeof(union _Bstr) <= val->key_len) {
+	return STR_PTR;
+    }
+    if ((int)sizeof(val->key.ca) <= val->key_len) {
+	return STR_BLOCK;
+    }
+    return STR_ARRAY;
+}
+
+static inline const char*
+_ojc_key_ptr(ojcVal val) {
+    switch (_ojc_key_kind(val)) {
+    case STR_NONE:	return NULL;
+    case STR_REF:
+    case STR_INTERN:
+    case STR_PTR:	return val->key.str;
+    case STR_BLOCK:	return val->key.bstr->ca;
+    default:		break;
+    }
+    return val->key.ca;
+}
+
+static inline int
+_ojc_key_len(ojcVal val) {
+    switch (_ojc_key_kind(val)) {
+    case STR_NONE:	return 0;
+    case STR_REF:
+    case STR_INTERN:	return val->key_len & ~(KEY_REF_FLAG | KEY_INTERN_FLAG);
+    default:		break;
+    }
+    if (KEY_BIG == val->key_len) {
+	return (int)strlen(val->key.str);
+    }
+    return val->key_len;
+}
+
+static inline bool
+_ojc_key_terminated(ojcVal val) {
+    return STR_REF != _ojc_key_kind(val) || '\0' == val->key.str[_ojc_key_len(val)];
+}
+
 extern void	_ojc_val_cleanup(void) ;
 
 extern ojcVal	_ojc_val_create(ojcValType type);
@@ -8,10 +8,15 @@
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include <ctype.h>
 #include <math.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
 #include "ut.h"
+#include "ojc/reader.h"
 
 static const char	bench_json[] = "{\"a\":\"Alpha\",\"b\":true,\"c\":12345,\"d\":[true,[false,[-123456789,null],3.9676,[\"Something else.\",false],null]],\"e\":{\"zero\":null,\"one\":1,\"two\":2,\"three\":[3],\"four\":[0,1,2,3,4]},\"f\":null,\"h\":{\"a\":{\"b\":{\"c\":{\"d\":{\"e\":{\"f\":{\"g\":null}}}}}}},\"i\":[[[[[[[null]]]]]]]}";
 
@@ -96,9 +101,11 @@ string_test() {
 	0 };
 
     in_and_out(jsons);
+    ojc_parse_newline_ok = true;
     ojc_newline_ok = true;
     in_and_out(newline_jsons);
     ojc_newline_ok = false;
+    ojc_parse_newline_ok = false;
 }
 
 static void
@@ -121,6 +128,7 @@ number_test() {
 	"-123",
 	"9223372036854775807",
 	"-9223372036854775807",
+	"-9223372036854775808",
 	"1.23",
 	"-1.00023",
 	"1.00000123e-08",
@@ -130,6 +138,54 @@ number_test() {
     in_and_out(jsons);
 }
 
+static void
+decimal_test() {
+    struct _ojcErr	err = OJC_ERR_INIT;
+    ojcVal		val;
+    ojcVal		m;
+    double		expect[] = {
+	-122.419415,
+	37.774929,
+	0.1,
+	110000.0,
+	1.5e-30,
+	1.79769313486231e308,
+	2.2250738585072e-308,
+	4.94065645841247e-324,
+	9.00719925474099e15,
+	0.0000000000000000000012345,
+	123456789012345.0,
+    };
+    int			i;
+
+    val = ojc_parse_str(&err, "[-122.419415,37.774929,0.1,1.1e+05,1.5e-30,1.79769313486231e308,"
+			"2.2250738585072e-308,4.94065645841247e-324,9.00719925474099e15,"
+			"0.0000000000000000000012345,123456789012345.00000,"
+			"1.2345678901234567,12345678901234567,-9223372036854775808]", 0, 0);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    for (i = 0; i < (int)(sizeof(expect) / sizeof(*expect)); i++) {
+	m = ojc_get_member(&err, val, i);
+	ut_same_int(OJC_DECIMAL, ojc_type(m), "type of member %d", i);
+	ut_true(expect[i] == ojc_double(&err, m));
+    }
+    // Too many significant digits for a double.
+    ut_same_int(OJC_NUMBER, ojc_type(ojc_get_member(&err, val, i)), "type of member %d", i);
+    i++;
+    ut_same_int(OJC_FIXNUM, ojc_type(ojc_get_member(&err, val, i)), "type of member %d", i);
+    i++;
+    m = ojc_get_member(&err, val, i);
+    ut_same_int(OJC_FIXNUM, ojc_type(m), "type of member %d", i);
+    ut_true(INT64_MIN == ojc_int(&err, m));
+    ojc_destroy(val);
+
+    // One past the most negative fixnum does not fit.
+    val = ojc_parse_str(&err, "-9223372036854775809", 0, 0);
+    ut_same_int(OJC_NUMBER, ojc_type(val), "type past the most negative");
+    ojc_destroy(val);
+}
+
 static void
 opaque_test() {
     char		result[64];
@@ -173,157 +229,1759 @@ mix_test() {
 	"{\"a\":\"Alpha\",\"b\":true,\"c\":12345,\"d\":[true,[false,[-123456789,null],3.9676,[\"Something else.\",false],null]],\"e\":{\"zero\":null,\"one\":1,\"two\":2,\"three\":[3],\"four\":[0,1,2,3,4]},\"f\":null,\"h\":{\"a\":{\"b\":{\"c\":{\"d\":{\"e\":{\"f\":{\"g\":null}}}}}}},\"i\":[[[[[[[null]]]]]]]}",
 	0 };
 
-    in_and_out(jsons);
+    in_and_out(jsons);
+}
+
+static void
+comment_test() {
+    ojcVal		val;
+    struct _ojcErr	err = OJC_ERR_INIT;
+    const char		*json = "{\n\
+  // a comment\n\
+  \"a\":\"Alpha\",\n\
+  // another comment\n\
+  \"b\":true,\n\
+  /* third comment */\n\
+  \"c\":12345\n\
+}";
+    char		result[256];
+
+    val = ojc_parse_str(&err, json, 0, 0);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    ojc_fill(&err, val, 0, result, sizeof(result) - 1);
+    ut_same("{\"a\":\"Alpha\",\"b\":true,\"c\":12345}", result);
+    ojc_destroy(val);
+
+    val = ojc_parse_str(&err, "[1,/** stars **/2]", 0, 0);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    ojc_fill(&err, val, 0, result, sizeof(result) - 1);
+    ut_same("[1,2]", result);
+    ojc_destroy(val);
+}
+
+static void
+index_test() {
+    ojcVal		val;
+    struct _ojcErr	err = OJC_ERR_INIT;
+    const char		*json = "[1 /* \"not a string */ ,\"a\\\\\",\"b\\\"c\"]";
+    char		result[256];
+    char		*big;
+    char		*s;
+    int			i;
+
+    val = ojc_parse_str(&err, json, 0, 0);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    ojc_fill(&err, val, 0, result, sizeof(result) - 1);
+    ut_same("[1,\"a\\\\\",\"b\\\"c\"]", result);
+    ojc_destroy(val);
+
+    // Long enough to cross index chunks with tokens on the boundaries.
+    big = (char*)malloc(100000);
+    s = big;
+    *s++ = '[';
+    for (i = 0; i < 3000; i++) {
+	s += sprintf(s, "{\"k%d\":\"v%d\",\"n\":-%d.5},", i, i, i);
+    }
+    s += sprintf(s, "true]");
+    val = ojc_parse_str(&err, big, 0, 0);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    ut_same_int(3001, ojc_member_count(&err, val), "member count");
+    ut_same("v2999", ojc_str(&err, ojc_get(val, "2999/k2999")));
+    ojc_destroy(val);
+
+    // An error deep in the input still reports the right line.
+    strcpy(s - 1, "\n\n,]");
+    ojc_parse_str(&err, big, 0, 0);
+    ut_same_int(OJC_PARSE_ERR, err.code, "error code");
+    ut_true(NULL != strstr(err.msg, "line 3"));
+    free(big);
+}
+
+static bool
+each_callback(ojcErr err, ojcVal val, void *ctx) {
+    char		*result = (char*)ctx;
+    int			cnt;
+
+    for (; '\0' != *result; result++) {
+    }
+    cnt = ojc_fill(err, val, 0, result, 32);
+    result[cnt] = '\n';
+    result[cnt + 1] = '\0';
+
+    return true;
+}
+
+static void
+each_test() {
+    const char	*json = "\n\
+null\n\
+{}\n\
+[]\n\
+\"hello\"\n\
+";
+    char		result[256];
+    struct _ojcErr	err;
+
+    ojc_err_init(&err);
+    *result = '\n';
+    result[1] = '\0';
+    ojc_parse_str(&err, json, each_callback, result);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    ut_same(json, result);
+}
+
+static bool
+keep_callback(ojcErr err, ojcVal val, void *ctx) {
+    *(ojcVal*)ctx = val;
+
+    return false;
+}
+
+static void
+parser_test() {
+    const char		*json = "\n\
+null\n\
+{\"a\":[1,2.5,\"split\"],\"b\":true}\n\
+[]\n\
+\"hello\"\n\
+";
+    char		result[256];
+    struct _ojcErr	err = OJC_ERR_INIT;
+    ojcParser		parser;
+    const char		*s;
+    int			line;
+    int			col;
+
+    // Feed one byte at a time so every token is split.
+    *result = '\n';
+    result[1] = '\0';
+    parser = ojc_parser_create(each_callback, result);
+    for (s = json; '\0' != *s; s++) {
+	ojc_parser_feed(&err, parser, s, 1);
+    }
+    ojc_parser_finish(&err, parser);
+    ojc_parser_destroy(parser);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    ut_same(json, result);
+
+    // A number at the end is only complete when finished.
+    *result = '\0';
+    parser = ojc_parser_create(each_callback, result);
+    ojc_parser_feed(&err, parser, "[1] 12", 6);
+    ut_same("[1]\n", result);
+    ojc_parser_finish(&err, parser);
+    ut_same("[1]\n12\n", result);
+    ojc_parser_destroy(parser);
+
+    parser = ojc_parser_create(each_callback, result);
+    ojc_parser_feed(&err, parser, "{\"a\":\n[1,", 9);
+    ut_same_int(OJC_OK, err.code, "partial");
+    ut_same_int(9, ojc_parser_position(parser, &line, &col), "position");
+    ut_same_int(2, line, "line");
+    ut_same_int(4, col, "column");
+    ojc_parser_finish(&err, parser);
+    ut_same_int(OJC_INCOMPLETE_ERR, err.code, "incomplete");
+    ojc_parser_destroy(parser);
+
+    ojc_err_init(&err);
+    parser = ojc_parser_create(each_callback, result);
+    ojc_parser_feed(&err, parser, "[1,\n2 3]", 8);
+    ut_same_int(OJC_PARSE_ERR, err.code, "error code");
+    ut_true(NULL != strstr(err.msg, "line 2, column 4 "));
+    ojc_parser_destroy(parser);
+
+    // Large tokens fed a byte at a time are only scanned once. Rescanning
+    // them on every feed would take minutes.
+    int		big = 1000000;
+    char	*buf = (char*)malloc(3 * big + 32);
+    char	*b = buf;
+    ojcVal	val = NULL;
+
+    b = stpcpy(b, "[\"");
+    for (int i = big / 5; 0 < i; i--) {
+	b = stpcpy(b, "abc\\n");
+    }
+    b = stpcpy(b, "\",/*");
+    memset(b, '*', big);
+    b += big;
+    b = stpcpy(b, "/");
+    memset(b, '7', big);
+    b += big;
+    b = stpcpy(b, "]");
+    ojc_err_init(&err);
+    parser = ojc_parser_create(keep_callback, &val);
+    for (s = buf; s < b; s++) {
+	ojc_parser_feed(&err, parser, s, 1);
+    }
+    ojc_parser_finish(&err, parser);
+    ojc_parser_destroy(parser);
+    free(buf);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    ut_same_int(2, ojc_member_count(&err, val), "members");
+    ut_same_int(big / 5 * 4, ojc_str_len(&err, ojc_get_member(&err, val, 0)), "string length");
+    ut_same_int(OJC_NUMBER, ojc_type(ojc_get_member(&err, val, 1)), "number type");
+    ojc_destroy(val);
+}
+
+static void
+file_parse_test() {
+    FILE		*f = fopen("tmp.json", "w");
+    char		result[300];
+    struct _ojcErr	err;
+    ojcVal		val;
+
+    fwrite(bench_json, sizeof(bench_json) - 1, 1, f);
+    fclose(f);
+
+    ojc_err_init(&err);
+    f = fopen("tmp.json", "r");
+    val = ojc_parse_file(&err, f, 0, 0);
+    fclose(f);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    ojc_fill(&err, val, 0, result, sizeof(result));
+
+    ut_same(bench_json, result);
+}
+
+static const char	*follow_json2 = "[3,2,1]";
+
+static bool
+follow_callback(ojcErr err, ojcVal val, void *ctx) {
+    ojcVal	*vp = (ojcVal*)ctx;
+    
+    if (0 == *vp) {
+	FILE		*f = fopen("tmp.json", "a");
+	
+	// write string and terminating \0
+	fwrite(follow_json2, 1, strlen(follow_json2) + 1, f);
+	fclose(f);
+    } else {
+	ojc_destroy(*vp);
+    }
+    *vp = val;
+
+    return false;
+}
+
+static void
+follow_parse_test() {
+    FILE		*f = fopen("tmp.json", "w");
+    char		result[300];
+    struct _ojcErr	err;
+    ojcVal		val = NULL;
+    const char		*json = "[1,2,3,4]";
+
+    fwrite(json, 1, strlen(json), f);
+    fclose(f);
+
+    ojc_err_init(&err);
+    f = fopen("tmp.json", "r");
+    ojc_parse_file_follow(&err, f, follow_callback, &val);
+    fclose(f);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    ojc_fill(&err, val, 0, result, sizeof(result));
+
+    ut_same(follow_json2, result);
+}
+
+// Replaces the followed file with a shorter one after the first value, the
+// first time by truncating and the second time by rotating.
+static bool
+follow_rotate_callback(ojcErr err, ojcVal val, void *ctx) {
+    ojcVal	*vp = (ojcVal*)ctx;
+    FILE	*f;
+
+    if (0 == *vp) {
+	if (1 == ojc_member_count(err, val)) {
+	    rename("tmp.json", "tmp.json.old");
+	}
+	f = fopen("tmp.json", "w");
+	fwrite(follow_json2, 1, strlen(follow_json2) + 1, f);
+	fclose(f);
+    } else {
+	ojc_destroy(*vp);
+    }
+    *vp = val;
+
+    return false;
+}
+
+static void
+follow_rotate_test() {
+    const char		*json[] = { "[1,2,3,4,5,6,7,8,9]", "[1]" };
+    FILE		*f;
+    char		result[300];
+    struct _ojcErr	err;
+    ojcVal		val;
+    struct stat		before;
+    struct stat		after;
+    int			i;
+
+    for (i = 0; i < 2; i++) {
+	f = fopen("tmp.json", "w");
+	fwrite(json[i], 1, strlen(json[i]), f);
+	fclose(f);
+
+	val = NULL;
+	ojc_err_init(&err);
+	f = fopen("tmp.json", "r");
+	fstat(fileno(f), &before);
+	ojc_parse_file_follow(&err, f, follow_rotate_callback, &val);
+	// The rotated file is opened by the parser, not in place of f.
+	fstat(fileno(f), &after);
+	ut_true(before.st_ino == after.st_ino && before.st_dev == after.st_dev);
+	fclose(f);
+	if (ut_handle_error(&err)) {
+	    return;
+	}
+	ojc_fill(&err, val, 0, result, sizeof(result));
+	ut_same(follow_json2, result);
+	ojc_destroy(val);
+    }
+    remove("tmp.json.old");
+}
+
+static void
+pretty_parse_test() {
+    FILE		*f = fopen("tmp.json", "w");
+    char		result[300];
+    struct _ojcErr	err;
+    ojcVal		val;
+    char		*pretty;
+
+    ojc_err_init(&err);
+    val = ojc_parse_str(&err, bench_json, 0, 0);
+    pretty = ojc_to_str(val, 4);
+    ojc_destroy(val);
+    fprintf(f, "%s\n\t  \n", pretty);
+    fclose(f);
+    free(pretty);
+
+    f = fopen("tmp.json", "r");
+    val = ojc_parse_file(&err, f, 0, 0);
+    fclose(f);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    ojc_fill(&err, val, 0, result, sizeof(result));
+    ut_same(bench_json, result);
+    ojc_destroy(val);
+
+    f = fopen("tmp.json", "w");
+    fprintf(f, "\t  \n                                 [1,\n  2 3]");
+    fclose(f);
+    f = fopen("tmp.json", "r");
+    val = ojc_parse_file(&err, f, 0, 0);
+    fclose(f);
+    ut_same_int(OJC_PARSE_ERR, err.code, "error code");
+    ut_true(NULL != strstr(err.msg, "line 3, column 6 "));
+}
+
+static void
+path_parse_test() {
+    const char		*json = "\n\
+null\n\
+{}\n\
+[]\n\
+\"hello\"\n\
+";
+    FILE		*f = fopen("tmp.json", "w");
+    char		result[256];
+    struct _ojcErr	err = OJC_ERR_INIT;
+    ojcVal		val;
+
+    fwrite(bench_json, sizeof(bench_json) - 1, 1, f);
+    fclose(f);
+    val = ojc_parse_path(&err, "tmp.json", 0, 0);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    ojc_fill(&err, val, 0, result, sizeof(result));
+    ut_same(bench_json, result);
+    ojc_destroy(val);
+
+    f = fopen("tmp.json", "w");
+    fputs(json, f);
+    fclose(f);
+    *result = '\n';
+    result[1] = '\0';
+    ojc_parse_path(&err, "tmp.json", each_callback, result);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    ut_same(json, result);
+
+    f = fopen("tmp.json", "w");
+    fprintf(f, "\t  \n                                 [1,\n  2 3]");
+    fclose(f);
+    val = ojc_parse_path(&err, "tmp.json", 0, 0);
+    ut_same_int(OJC_PARSE_ERR, err.code, "error code");
+    ut_true(NULL != strstr(err.msg, "line 3, column 6 "));
+    ojc_destroy(val);
+
+    ojc_err_init(&err);
+    val = ojc_parse_path(&err, "not-a-file.json", 0, 0);
+    ut_same_int(OJC_ARG_ERR, err.code, "missing file");
+    ut_true(NULL == val);
+
+    // A file that fills whole pages and ends in a word or number must not be
+    // read past its last byte.
+    long	psize = sysconf(_SC_PAGESIZE);
+    const char	*ends[] = { "tru", "nul", "12345.678e-3", NULL };
+
+    for (const char **ep = ends; NULL != *ep; ep++) {
+	size_t	elen = strlen(*ep);
+
+	f = fopen("tmp.json", "w");
+	for (long i = psize * 2 - (long)elen; 0 < i; i--) {
+	    putc(' ', f);
+	}
+	fputs(*ep, f);
+	fclose(f);
+	ojc_err_init(&err);
+	val = ojc_parse_path(&err, "tmp.json", 0, 0);
+	if ('1' == **ep) {
+	    ut_same_int(OJC_OK, err.code, "number at end of file");
+	    ut_true(12.345678 == ojc_double(&err, val));
+	} else {
+	    ut_true(OJC_OK != err.code);
+	}
+	ojc_destroy(val);
+    }
+}
+
+static int
+uring_str_len(int n) {
+    return 500 + (n * 97) % 4000;
+}
+
+// Counts documents, sums n, and counts strings that are not as written.
+static bool
+uring_callback(ojcErr err, ojcVal val, void *ctx) {
+    int64_t	*sums = (int64_t*)ctx;
+    int		n = (int)ojc_int(err, ojc_get(val, "n"));
+    ojcVal	s = ojc_get(val, "s");
+    const char	*str = ojc_str(err, s);
+    int		len = uring_str_len(n);
+    int		k;
+
+    sums[0]++;
+    sums[1] += n;
+    if (len != ojc_str_len(err, s)) {
+	sums[2]++;
+	return true;
+    }
+    for (k = 0; k < len; k++) {
+	if ('a' + (n + len - k) % 26 != str[k]) {
+	    sums[2]++;
+	    break;
+	}
+    }
+    return true;
+}
+
+// Falls back to plain reads where io_uring is not available so the results
+// are the same either way.
+static void
+uring_parse_test() {
+    FILE		*f = fopen("tmp.json", "w");
+    char		result[300];
+    struct _ojcErr	err = OJC_ERR_INIT;
+    ojcVal		val;
+    int			fds[2];
+
+    ojc_io_uring = true;
+    fwrite(bench_json, sizeof(bench_json) - 1, 1, f);
+    fclose(f);
+    f = fopen("tmp.json", "r");
+    val = ojc_parse_file(&err, f, 0, 0);
+    ut_same_int((int)sizeof(bench_json) - 1, (int)ftell(f), "file position");
+    fclose(f);
+    if (ut_handle_error(&err)) {
+	ojc_io_uring = false;
+	return;
+    }
+    ojc_fill(&err, val, 0, result, sizeof(result));
+    ut_same(bench_json, result);
+    ojc_destroy(val);
+
+    if (0 == pipe(fds)) {
+	ssize_t	cnt = write(fds[1], bench_json, sizeof(bench_json) - 1);
+
+	close(fds[1]);
+	ut_same_int((int)sizeof(bench_json) - 1, (int)cnt, "write");
+	val = ojc_parse_fd(&err, fds[0], 0, 0);
+	close(fds[0]);
+	if (!ut_handle_error(&err)) {
+	    ojc_fill(&err, val, 0, result, sizeof(result));
+	    ut_same(bench_json, result);
+	}
+	ojc_destroy(val);
+    }
+
+    // Several times all the io_uring buffers with strings that cross from
+    // one buffer to the next and from the last back to the first.
+    char	*json = (char*)malloc(0x00100000 + 5000);
+    char	*end = json;
+    int64_t	sum = 0;
+    int		i;
+    int		k;
+
+    for (i = 0; 0x00100000 > end - json; i++) {
+	end += sprintf(end, "{\"n\":%d,\"s\":\"", i);
+	for (k = uring_str_len(i); 0 < k; k--) {
+	    *end++ = 'a' + (i + k) % 26;
+	}
+	end += sprintf(end, "\"}\n");
+	sum += i;
+    }
+    *end = '\0';
+    ut_true(4 * 4 * 0x00010000 < end - json);
+    f = fopen("tmp.json", "w");
+    fwrite(json, 1, end - json, f);
+    fclose(f);
+    for (int src = 0; src < 3; src += 2) {
+	int64_t	sums[3] = { 0, 0, 0 };
+
+	if (0 == src) {
+	    f = fopen("tmp.json", "r");
+	    ojc_parse_file(&err, f, uring_callback, sums);
+	    fclose(f);
+	} else if (0 == pipe(fds)) {
+	    if (0 == fork()) {
+		size_t	len = end - json;
+		ssize_t	cnt;
+		char	*j = json;
+
+		close(fds[0]);
+		for (; 0 < len; len -= cnt, j += cnt) {
+		    if (0 >= (cnt = write(fds[1], j, len))) {
+			break;
+		    }
+		}
+		_exit(0);
+	    }
+	    close(fds[1]);
+	    ojc_parse_fd(&err, fds[0], uring_callback, sums);
+	    close(fds[0]);
+	    wait(NULL);
+	}
+	if (ut_handle_error(&err)) {
+	    break;
+	}
+	ut_same_int(i, sums[0], "document count");
+	ut_same_int(sum, sums[1], "sum");
+	ut_same_int(0, sums[2], "bad strings");
+    }
+    free(json);
+    ojc_io_uring = false;
+}
+
+static ssize_t
+my_read_func(void *src, char *buf, size_t size) {
+    return fread(buf, 1, size, (FILE*)src);
+}
+
+static void
+func_parse_test() {
+    FILE		*f = fopen("tmp.json", "w");
+    char		result[300];
+    struct _ojcErr	err;
+    ojcVal		val;
+
+    fwrite(bench_json, sizeof(bench_json) - 1, 1, f);
+    fclose(f);
+
+    ojc_err_init(&err);
+    f = fopen("tmp.json", "r");
+    val = ojc_parse_reader(&err, f, my_read_func, 0, 0);
+    fclose(f);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    ojc_fill(&err, val, 0, result, sizeof(result));
+
+    ut_same(bench_json, result);
+}
+
+// Lends the input in chunks that get longer each time so tokens cross
+// chunks at many different points.
+typedef struct _LendSrc {
+    const char	*json;
+    size_t	len;
+    size_t	step;
+    const char	*lent;
+    int		lends;
+    int		releases;
+    int		early;	// releases of something other than the last lent
+} *LendSrc;
+
+static ssize_t
+lend_func(void *src, const char **bufp) {
+    LendSrc	ls = (LendSrc)src;
+    size_t	cnt = 1 + ls->step++ % 41;
+
+    if (cnt > ls->len) {
+	cnt = ls->len;
+    }
+    *bufp = ls->json;
+    ls->lent = ls->json;
+    ls->json += cnt;
+    ls->len -= cnt;
+    if (0 < cnt) {
+	ls->lends++;
+    }
+    return (ssize_t)cnt;
+}
+
+static void
+release_func(void *src, const char *buf) {
+    LendSrc	ls = (LendSrc)src;
+
+    if (buf != ls->lent) {
+	ls->early++;
+    }
+    ls->releases++;
+}
+
+// Lends each chunk in an allocation of exactly its size so a read past the
+// end of a chunk is caught by address checkers.
+static ssize_t
+exact_lend_func(void *src, const char **bufp) {
+    LendSrc	ls = (LendSrc)src;
+    size_t	cnt = 1 + ls->step++ % 7;
+    char	*chunk;
+
+    if (cnt > ls->len) {
+	cnt = ls->len;
+    }
+    if (0 == cnt) {
+	return 0;
+    }
+    chunk = (char*)malloc(cnt);
+    memcpy(chunk, ls->json, cnt);
+    *bufp = chunk;
+    ls->json += cnt;
+    ls->len -= cnt;
+    ls->lends++;
+
+    return (ssize_t)cnt;
+}
+
+static void
+exact_release_func(void *src, const char *buf) {
+    ((LendSrc)src)->releases++;
+    free((char*)buf);
+}
+
+static void
+lend_parse_test() {
+    struct _ojcErr	err = OJC_ERR_INIT;
+    char		*json = (char*)malloc(20100);
+    char		result[20200];
+    struct _LendSrc	ls;
+    ojcVal		val;
+    int			i;
+
+    strcpy(json, "[\"");
+    for (i = 2; i < 20000; i++) {
+	json[i] = 'a' + i % 26;
+    }
+    strcpy(json + i, "\",-12.5e3, true, \"a\\u00e9b\", /* c */ {\"key\":null}, 123]");
+    memset(&ls, 0, sizeof(ls));
+    ls.json = json;
+    ls.len = strlen(json);
+    ls.step = 1;
+    val = ojc_parse_lender(&err, &ls, lend_func, release_func, 0, 0);
+    if (!ut_handle_error(&err)) {
+	ojc_fill(&err, val, 0, result, sizeof(result));
+	ut_same_int(0, strncmp(json, result, 20000), "long string");
+	ut_same("\",-12500.0,true,\"a\xc3\xa9" "b\",{\"key\":null},123]", result + 20000);
+	ojc_destroy(val);
+    }
+    ut_same_int(ls.lends, ls.releases, "releases");
+    ut_same_int(0, ls.early, "early releases");
+
+    memset(&ls, 0, sizeof(ls));
+    ls.json = bench_json;
+    ls.len = sizeof(bench_json) - 1;
+    val = ojc_parse_lender(&err, &ls, lend_func, NULL, 0, 0);
+    if (!ut_handle_error(&err)) {
+	ojc_fill(&err, val, 0, result, sizeof(result));
+	ut_same(bench_json, result);
+	ojc_destroy(val);
+    }
+    free(json);
+
+    // Nothing follows a lent chunk so every token ends inside one at some
+    // step.
+    const char	*words = "[true,null,12.5e3,-7,\"ab\\n\",false] /* c */ // x\n";
+
+    for (i = 0; i < 7; i++) {
+	memset(&ls, 0, sizeof(ls));
+	ls.json = words;
+	ls.len = strlen(words);
+	ls.step = i;
+	val = ojc_parse_lender(&err, &ls, exact_lend_func, exact_release_func, 0, 0);
+	if (ut_handle_error(&err)) {
+	    break;
+	}
+	ojc_fill(&err, val, 0, result, sizeof(result));
+	ut_same("[true,null,12500.0,-7,\"ab\\n\",false]", result);
+	ojc_destroy(val);
+	ut_same_int(ls.lends, ls.releases, "exact releases");
+    }
+}
+
+static bool
+ahead_callback(ojcErr err, ojcVal val, void *ctx) {
+    int64_t	*sums = (int64_t*)ctx;
+
+    sums[0]++;
+    sums[1] += ojc_int(err, ojc_get(val, "n"));
+
+    return true;
+}
+
+// Stops the parse after 1000 documents.
+static bool
+ahead_stop_callback(ojcErr err, ojcVal val, void *ctx) {
+    int64_t	*sums = (int64_t*)ctx;
+
+    if (1000 <= ++sums[0]) {
+	err->code = OJC_ABORT_ERR;
+	strcpy(err->msg, "stop");
+    }
+    return true;
+}
+
+static int
+thread_count() {
+    FILE	*f = fopen("/proc/self/status", "r");
+    char	line[256];
+    int		cnt = -1;
+
+    if (NULL == f) {
+	return -1;
+    }
+    while (NULL != fgets(line, sizeof(line), f)) {
+	if (1 == sscanf(line, "Threads: %d", &cnt)) {
+	    break;
+	}
+    }
+    fclose(f);
+
+    return cnt;
+}
+
+// Parses json from tmp.json, a read function, or a pipe depending on src.
+static void
+ahead_parse(ojcErr err, int src, const char *json, ojcParseCallback cb, int64_t *sums) {
+    FILE	*f;
+    int		fds[2];
+
+    switch (src) {
+    case 0:
+	f = fopen("tmp.json", "r");
+	ojc_destroy(ojc_parse_file(err, f, cb, sums));
+	fclose(f);
+	break;
+    case 1:
+	f = fopen("tmp.json", "r");
+	ojc_destroy(ojc_parse_reader(err, f, my_read_func, cb, sums));
+	fclose(f);
+	break;
+    default:
+	if (0 != pipe(fds)) {
+	    return;
+	}
+	if (0 == fork()) {
+	    size_t	len = strlen(json);
+	    ssize_t	cnt;
+
+	    close(fds[0]);
+	    for (; 0 < len; len -= cnt, json += cnt) {
+		if (0 >= (cnt = write(fds[1], json, len))) {
+		    break;
+		}
+	    }
+	    _exit(0);
+	}
+	close(fds[1]);
+	ojc_destroy(ojc_parse_fd(err, fds[0], cb, sums));
+	// A writer still blocked on a full pipe gets SIGPIPE and exits.
+	close(fds[0]);
+	wait(NULL);
+	break;
+    }
+}
+
+static void
+read_ahead_test() {
+    struct _ojcErr	err = OJC_ERR_INIT;
+    FILE		*f = fopen("tmp.json", "w");
+    char		*json = (char*)malloc(1000000);
+    char		*end = json;
+    int64_t		sum = 0;
+    int			threads = thread_count();
+    int			i;
+    int			src;
+
+    // Enough documents to fill all the read-ahead buffers a few times over.
+    for (i = 0; i < 20000; i++) {
+	end += sprintf(end, "{\"n\":%d,\"s\":\"read ahead\"}\n", i);
+	sum += i;
+    }
+    fwrite(json, 1, end - json, f);
+    fclose(f);
+
+    ojc_read_ahead = true;
+    for (src = 0; src < 3; src++) {
+	int64_t	sums[2] = { 0, 0 };
+
+	ahead_parse(&err, src, json, ahead_callback, sums);
+	if (ut_handle_error(&err)) {
+	    break;
+	}
+	ut_same_int(i, sums[0], "document count");
+	ut_same_int(sum, sums[1], "sum");
+    }
+
+    // A callback error stops the parse with most of the input unread. The
+    // call still returns and the read-ahead thread is gone.
+    for (src = 0; src < 3; src++) {
+	int64_t	sums[2] = { 0, 0 };
+
+	ojc_err_init(&err);
+	ahead_parse(&err, src, json, ahead_stop_callback, sums);
+	ut_same_int(OJC_ABORT_ERR, err.code, "abort error code");
+	ut_same_int(1000, sums[0], "documents before abort");
+	ut_same_int(threads, thread_count(), "threads after abort");
+    }
+
+    // So does a parse error part way through.
+    memcpy(strstr(json, "{\"n\":5000,"), "{\"n\":50x0,", 10);
+    f = fopen("tmp.json", "w");
+    fwrite(json, 1, end - json, f);
+    fclose(f);
+    for (src = 0; src < 3; src++) {
+	int64_t	sums[2] = { 0, 0 };
+
+	ojc_err_init(&err);
+	ahead_parse(&err, src, json, ahead_callback, sums);
+	ut_same_int(OJC_PARSE_ERR, err.code, "parse error code");
+	ut_same_int(5000, sums[0], "documents before error");
+	ut_same_int(threads, thread_count(), "threads after error");
+    }
+    ojc_read_ahead = false;
+    free(json);
+}
+
+typedef struct _ParCount {
+    atomic_llong	cnt;
+    atomic_llong	sum;
+    bool		ordered;
+    int64_t		next;	// next n expected when ordered
+    bool		in_order;
+} *ParCount;
+
+static bool
+parallel_callback(ojcErr err, ojcVal val, void *ctx) {
+    ParCount	pc = (ParCount)ctx;
+    int64_t	n = ojc_int(err, ojc_get(val, "n"));
+
+    if (pc->ordered) {
+	if (n != pc->next) {
+	    pc->in_order = false;
+	}
+	pc->next = n + 1;
+    }
+    atomic_fetch_add(&pc->cnt, 1);
+    atomic_fetch_add(&pc->sum, n);
+
+    return true;
+}
+
+static void
+parallel_check(ojcErr err, int flags, int64_t cnt, int64_t sum) {
+    struct _ParCount	pc;
+
+    atomic_init(&pc.cnt, 0);
+    atomic_init(&pc.sum, 0);
+    pc.ordered = (0 == (flags & OJC_UNORDERED));
+    pc.next = 0;
+    pc.in_order = true;
+    ojc_parse_file_parallel(err, "tmp.json", 4, parallel_callback, &pc, flags);
+    ut_same_int(cnt, atomic_load(&pc.cnt), "document count");
+    ut_same_int(sum, atomic_load(&pc.sum), "sum");
+    ut_true(pc.in_order);
+}
+
+static void
+parallel_test() {
+    struct _ojcErr	err = OJC_ERR_INIT;
+    struct _ojcErr	serr = OJC_ERR_INIT;
+    FILE		*f = fopen("tmp.json", "w");
+    int64_t		sum = 0;
+    int			i;
+
+    // Enough lines for several chunks.
+    for (i = 0; i < 100000; i++) {
+	fprintf(f, "{\"n\":%d,\"s\":\"parallel\"}\n", i);
+	sum += i;
+    }
+    fclose(f);
+    parallel_check(&err, 0, i, sum);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    parallel_check(&err, OJC_UNORDERED, i, sum);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+
+    // Values before an error are still delivered in order and the error
+    // is the same as from a single threaded parse.
+    f = fopen("tmp.json", "w");
+    for (i = 0, sum = 0; i < 100000; i++) {
+	fprintf(f, "{\"n\":%d,%s\"s\":\"parallel\"}\n", i, 70000 == i ? "," : "");
+	if (i < 70000) {
+	    sum += i;
+	}
+    }
+    fclose(f);
+    parallel_check(&err, 0, 70000, sum);
+    ojc_destroy(ojc_parse_path(&serr, "tmp.json", ahead_callback, (int64_t[2]){ 0, 0 }));
+    ut_same_int(OJC_PARSE_ERR, err.code, "error code");
+    ut_same(serr.msg, err.msg);
+    ut_true(NULL != strstr(err.msg, "line 70001, column 13"));
+}
+
+static bool
+split_callback(ojcErr err, ojcVal val, void *ctx) {
+    int64_t	*next = (int64_t*)ctx;
+
+    if (*next == ojc_int(err, ojc_get(val, "n"))) {
+	*next += 1;
+    }
+    return true;
+}
+
+static void
+split_parse_test() {
+    struct _ojcErr	err = OJC_ERR_INIT;
+    struct _ojcErr	serr = OJC_ERR_INIT;
+    char		*json = (char*)malloc(20000000);
+    char		*end = json;
+    ojcVal		expect;
+    ojcVal		val;
+    int64_t		next = 0;
+    FILE		*f;
+    char		*bad;
+    int			i;
+
+    // Strings and nesting that look like element boundaries and one element
+    // bigger than the window used to guess where elements start.
+    *end++ = '[';
+    for (i = 0; i < 100000; i++) {
+	if (0 < i) {
+	    *end++ = ',';
+	}
+	end += sprintf(end, "{\"n\":%d,\"s\":\"a\\\"},{\\\"k\\\":[1,\",\"t\":[{\"u\":[%d,{\"v\":\"\\\\\"}]}]}\n", i, i);
+	if (50000 == i) {
+	    end += sprintf(end, ",{\"n\":-1,\"big\":\"");
+	    for (int j = 0; j < 100000; j++) {
+		end += sprintf(end, "},{],[");
+	    }
+	    end += sprintf(end, "\"}");
+	}
+    }
+    strcpy(end, "]\n");
+    expect = ojc_parse_str(&err, json, 0, 0);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    ojc_parse_threads = 4;
+    val = ojc_parse_str(&err, json, 0, 0);
+    if (!ut_handle_error(&err)) {
+	ut_same_int(100001, ojc_member_count(&err, val), "member count");
+	ut_true(ojc_equals(expect, val));
+	ojc_destroy(val);
+    }
+    ojc_parse_str(&err, json, split_callback, &next);
+    ut_same_int(100000, next, "elements in order");
+
+    f = fopen("tmp.json", "w");
+    fputs(json, f);
+    fclose(f);
+    val = ojc_parse_path(&err, "tmp.json", 0, 0);
+    ut_true(ojc_equals(expect, val));
+    ojc_destroy(val);
+    f = fopen("tmp.json", "r");
+    val = ojc_parse_file(&err, f, 0, 0);
+    fclose(f);
+    ut_true(ojc_equals(expect, val));
+    ojc_destroy(val);
+    ojc_destroy(expect);
+
+    // Errors are the same as from a single threaded parse.
+    bad = strstr(json, "{\"n\":70000,");
+    bad[4] = ';';
+    ojc_parse_str(&err, json, 0, 0);
+    ojc_parse_threads = 0;
+    ojc_destroy(ojc_parse_str(&serr, json, 0, 0));
+    ut_same_int(OJC_PARSE_ERR, err.code, "error code");
+    ut_same(serr.msg, err.msg);
+    free(json);
+}
+
+#define CACHE_THREADS	4
+#define CACHE_TREES	64
+
+static ojcVal	cache_trees[CACHE_THREADS * CACHE_TREES];
+
+// Destroys trees made on the main thread then builds and destroys more so
+// values move between thread caches and the depot.
+static void*
+val_cache_thread(void *arg) {
+    ojcVal	*tp = (ojcVal*)arg;
+    ojcVal	v;
+    int		i;
+    int		j;
+
+    for (i = 0; i < CACHE_TREES; i++) {
+	ojc_destroy(tp[i]);
+    }
+    for (i = 0; i < 100; i++) {
+	v = ojc_create_array();
+	for (j = 0; j < 1000; j++) {
+	    ojc_array_append(NULL, v, ojc_create_str("a string longer than a short one", 32));
+	}
+	ojc_destroy(v);
+    }
+    return NULL;
 }
 
 static void
-comment_test() {
-    ojcVal		val;
+val_cache_test() {
     struct _ojcErr	err = OJC_ERR_INIT;
-    const char		*json = "{\n\
-  // a comment\n\
-  \"a\":\"Alpha\",\n\
-  // another comment\n\
-  \"b\":true,\n\
-  /* third comment */\n\
-  \"c\":12345\n\
-}";
-    char		result[256];
+    const char		*json = "[{\"a\":[1,2.5,\"a string longer than a short one\"],\"b\":null},true,\"x\"]";
+    pthread_t		threads[CACHE_THREADS];
+    ojcVal		val;
+    char		*out;
+    int			i;
 
+    for (i = 0; i < CACHE_THREADS * CACHE_TREES; i++) {
+	cache_trees[i] = ojc_parse_str(&err, json, 0, 0);
+	if (ut_handle_error(&err)) {
+	    return;
+	}
+    }
+    for (i = 0; i < CACHE_THREADS; i++) {
+	pthread_create(&threads[i], NULL, val_cache_thread, cache_trees + i * CACHE_TREES);
+    }
+    for (i = 0; i < CACHE_THREADS; i++) {
+	pthread_join(threads[i], NULL);
+    }
+    // The exited threads left their values in the depot.
     val = ojc_parse_str(&err, json, 0, 0);
     if (ut_handle_error(&err)) {
 	return;
     }
-    ojc_fill(&err, val, 0, result, sizeof(result) - 1);
-    ut_same("{\"a\":\"Alpha\",\"b\":true,\"c\":12345}", result);
+    out = ojc_to_str(val, 0);
+    ut_same(json, out);
+    free(out);
     ojc_destroy(val);
+    ojc_cleanup();
 }
 
-static bool
-each_callback(ojcErr err, ojcVal val, void *ctx) {
-    char		*result = (char*)ctx;
-    int			cnt;
-
-    for (; '\0' != *result; result++) {
+static void
+destroy_async_test() {
+    struct _ojcErr	err = OJC_ERR_INIT;
+    ojcVal		val;
+    ojcVal		obj;
+    int			i;
+
+    ojc_reclaim_threads = 3;
+    val = ojc_create_array();
+    for (i = 0; i < 10000; i++) {
+	obj = ojc_create_object();
+	ojc_object_append(&err, obj, "name", ojc_create_str("a string longer than a short one", 32));
+	ojc_object_append(&err, obj, "list", ojc_parse_str(&err, "[1,2,[3,{\"x\":null}]]", 0, 0));
+	ojc_array_append(&err, val, obj);
     }
-    cnt = ojc_fill(err, val, 0, result, 32);
-    result[cnt] = '\n';
-    result[cnt + 1] = '\0';
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    ut_same_int(0, ojc_destroy_async(val), "destroy large");
+    for (i = 0; i < 100; i++) {
+	ut_same_int(0, ojc_destroy_async(ojc_parse_str(&err, "{\"a\":[true,\"b\"]}", 0, 0)), "destroy small");
+    }
+    ut_same_int(0, ojc_destroy_async(NULL), "destroy NULL");
 
-    return true;
-}
+    val = ojc_create_int(7);
+    ojc_destroy(val);
+    ut_same_int(OJC_MEMORY_ERR, ojc_destroy_async(val), "destroy freed");
 
-static void
-each_test() {
-    const char	*json = "\n\
-null\n\
-{}\n\
-[]\n\
-\"hello\"\n\
-";
-    char		result[256];
-    struct _ojcErr	err;
+    // Waits for the reclaimers to finish and stops them.
+    ojc_cleanup();
+    ojc_reclaim_threads = 1;
+}
 
-    ojc_err_init(&err);
-    *result = '\n';
-    result[1] = '\0';
-    ojc_parse_str(&err, json, each_callback, result);
-    if (ut_handle_error(&err)) {
-	return;
+static bool
+dispatch_fail_callback(ojcErr err, ojcVal val, void *ctx) {
+    if (5000 <= ojc_int(err, ojc_get(val, "n"))) {
+	err->code = OJC_ABORT_ERR;
+	strcpy(err->msg, "stop");
     }
-    ut_same(json, result);
+    return true;
 }
 
 static void
-file_parse_test() {
+dispatch_test() {
+    struct _ojcErr	err = OJC_ERR_INIT;
+    struct _ParCount	pc;
     FILE		*f = fopen("tmp.json", "w");
-    char		result[300];
-    struct _ojcErr	err;
-    ojcVal		val;
+    int64_t		sum = 0;
+    int			i;
 
-    fwrite(bench_json, sizeof(bench_json) - 1, 1, f);
+    for (i = 0; i < 20000; i++) {
+	fprintf(f, "{\"n\":%d,\"s\":\"dispatched\"}\n", i);
+	sum += i;
+    }
     fclose(f);
 
-    ojc_err_init(&err);
+    // One thread calls back in order.
+    ojc_callback_threads = 1;
+    ojc_callback_queue = 8;
+    atomic_init(&pc.cnt, 0);
+    atomic_init(&pc.sum, 0);
+    pc.ordered = true;
+    pc.next = 0;
+    pc.in_order = true;
     f = fopen("tmp.json", "r");
-    val = ojc_parse_file(&err, f, 0, 0);
+    ojc_parse_file(&err, f, parallel_callback, &pc);
     fclose(f);
     if (ut_handle_error(&err)) {
 	return;
     }
-    ojc_fill(&err, val, 0, result, sizeof(result));
+    ut_same_int(20000, (int)atomic_load(&pc.cnt), "ordered count");
+    ut_true(sum == atomic_load(&pc.sum));
+    ut_true(pc.in_order);
+
+    ojc_callback_threads = 4;
+    atomic_init(&pc.cnt, 0);
+    atomic_init(&pc.sum, 0);
+    pc.ordered = false;
+    f = fopen("tmp.json", "r");
+    ojc_parse_fd(&err, fileno(f), parallel_callback, &pc);
+    fclose(f);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    ut_same_int(20000, (int)atomic_load(&pc.cnt), "unordered count");
+    ut_true(sum == atomic_load(&pc.sum));
 
-    ut_same(bench_json, result);
+    // A callback error stops the parse.
+    f = fopen("tmp.json", "r");
+    ojc_destroy(ojc_parse_file(&err, f, dispatch_fail_callback, NULL));
+    fclose(f);
+    ut_same_int(OJC_ABORT_ERR, err.code, "error code");
+    ut_same("stop", err.msg);
+
+    ojc_callback_threads = 0;
+    ojc_callback_queue = 64;
 }
 
-static const char	*follow_json2 = "[3,2,1]";
+static ssize_t
+trickle_read_func(void *src, char *buf, size_t size) {
+    const char	**sp = (const char**)src;
+    size_t	len = strlen(*sp);
 
-static bool
-follow_callback(ojcErr err, ojcVal val, void *ctx) {
-    ojcVal	*vp = (ojcVal*)ctx;
-    
-    if (0 == *vp) {
-	FILE		*f = fopen("tmp.json", "a");
-	
-	// write string and terminating \0
-	fwrite(follow_json2, 1, strlen(follow_json2) + 1, f);
-	fclose(f);
+    // Return small pieces so strings span many buffer reads.
+    if (37 < size) {
+	size = 37;
     }
-    *vp = val;
+    if (len < size) {
+	size = len;
+    }
+    memcpy(buf, *sp, size);
+    *sp += size;
 
-    return false;
+    return size;
 }
 
 static void
-follow_parse_test() {
-    FILE		*f = fopen("tmp.json", "w");
-    char		result[300];
-    struct _ojcErr	err;
-    ojcVal		val = NULL;
-    const char		*json = "[1,2,3,4]";
-
-    fwrite(json, 1, strlen(json), f);
-    fclose(f);
+long_str_test() {
+    struct _ojcErr	err = OJC_ERR_INIT;
+    ojcVal		val;
+    char		*json = (char*)malloc(20010);
+    const char		*src = json;
+    int			i;
 
-    ojc_err_init(&err);
-    f = fopen("tmp.json", "r");
-    ojc_parse_file_follow(&err, f, follow_callback, &val);
-    fclose(f);
+    *json = '"';
+    for (i = 1; i < 20000; i++) {
+	json[i] = 'a' + i % 26;
+    }
+    strcpy(json + i, "\\n\"");
+    val = ojc_parse_reader(&err, &src, trickle_read_func, 0, 0);
     if (ut_handle_error(&err)) {
 	return;
     }
-    ojc_fill(&err, val, 0, result, sizeof(result));
+    ut_same_int(20000, ojc_str_len(&err, val), "string length");
+    ut_same_int('\n', ojc_str(&err, val)[19999], "last character");
+    ojc_destroy(val);
 
-    ut_same(follow_json2, result);
+    // Control characters must be escaped.
+    json[100] = '\t';
+    src = json;
+    val = ojc_parse_reader(&err, &src, trickle_read_func, 0, 0);
+    ut_same_int(OJC_PARSE_ERR, err.code, "error code");
+    ut_true(NULL != strstr(err.msg, "column 101"));
+    ojc_err_init(&err);
+    val = ojc_parse_str(&err, json, 0, 0);
+    ut_same_int(OJC_PARSE_ERR, err.code, "error code");
+    free(json);
 }
 
+// Returns full reads until fewer than 200000 bytes are left and small ones
+// after that so the reader buffer grows and then shrinks.
 static ssize_t
-my_read_func(void *src, char *buf, size_t size) {
-    return fread(buf, 1, size, (FILE*)src);
+burst_read_func(void *src, char *buf, size_t size) {
+    const char	**sp = (const char**)src;
+    size_t	len = strlen(*sp);
+
+    if (len < 200000 && 37 < size) {
+	size = 37;
+    }
+    if (len < size) {
+	size = len;
+    }
+    memcpy(buf, *sp, size);
+    *sp += size;
+
+    return size;
+}
+
+typedef struct _Chunks {
+    const char	*s;
+    const char	*end;
+} *Chunks;
+
+// Returns at most a page at a time.
+static ssize_t
+chunk_read_func(void *src, char *buf, size_t size) {
+    Chunks	c = (Chunks)src;
+
+    if (0x00001000 < size) {
+	size = 0x00001000;
+    }
+    if ((size_t)(c->end - c->s) < size) {
+	size = c->end - c->s;
+    }
+    memcpy(buf, c->s, size);
+    c->s += size;
+
+    return size;
 }
 
+// Reads a string of big bytes and then small bytes of short values through a
+// reader the way the parser does. The string has to be in the buffer all at
+// once. Sets the largest buffer size and its kind and the size at the end.
 static void
-func_parse_test() {
-    FILE		*f = fopen("tmp.json", "w");
-    char		result[300];
-    struct _ojcErr	err;
+buf_sizes(size_t big, size_t small, size_t *maxp, int *kindp, size_t *lastp) {
+    struct _ojcErr	err = OJC_ERR_INIT;
+    struct _Reader	rd;
+    struct _Chunks	c;
+    char		*json = (char*)malloc(big + small + 2);
+    const char		*p;
+    const char		*q;
+    size_t		len;
+    size_t		size;
+
+    *json = '"';
+    memset(json + 1, 'x', big);
+    json[big + 1] = '"';
+    for (p = json + big + 2; p < json + big + small + 2; p += 2) {
+	memcpy((char*)p, "1,", 2);
+    }
+    c.s = json;
+    c.end = json + big + small + 2;
+    ojc_reader_init_func(&err, &rd, &c, chunk_read_func);
+    *maxp = 0;
+    *kindp = rd.free_head;
+    while (ojc_reader_span(&err, &rd, &p, &len)) {
+	if ('"' == *p) {
+	    rd.tail++;
+	    while (NULL == (q = (const char*)memchr(rd.tail, '"', rd.read_end - rd.tail)) &&
+		   ojc_reader_refill(&err, &rd, rd.tail)) {
+	    }
+	    rd.tail = (char*)(NULL == q ? rd.read_end : q + 1);
+	} else {
+	    rd.tail = rd.read_end;
+	}
+	if (*maxp < (size = rd.end - rd.head)) {
+	    *maxp = size;
+	    *kindp = rd.free_head;
+	}
+    }
+    *lastp = rd.end - rd.head;
+    ut_same_int(OJC_OK, err.code, "read error");
+    ojc_reader_cleanup(&rd);
+    free(json);
+}
+
+static void
+read_buf_test() {
+    struct _ojcErr	err = OJC_ERR_INIT;
     ojcVal		val;
+    char		*json = (char*)malloc(700010);
+    const char		*src;
+    char		*j = json;
+    int			i;
+    int			r;
+
+    *j++ = '[';
+    for (i = 0; i < 100000; i++) {
+	j += sprintf(j, "%d,", i);
+    }
+    strcpy(j, "\"end\"]");
+    for (r = 0; r < 3; r++) {
+	ojc_read_buf_size = 0 == r ? 16 : 0x00010000;
+	ojc_read_buf_max = 2 == r ? 0x00400000 : 0x00040000;
+	ojc_read_huge_pages = (2 == r);
+	src = json;
+	val = ojc_parse_reader(&err, &src, burst_read_func, 0, 0);
+	if (ut_handle_error(&err)) {
+	    break;
+	}
+	ut_same_int(100001, ojc_member_count(&err, val), "member count");
+	ut_same_int(99999, ojc_int(&err, ojc_get(val, "99999")), "last number");
+	ut_same("end", ojc_str(&err, ojc_get(val, "100000")));
+	ojc_destroy(val);
+    }
+    ojc_read_buf_size = 0x00001000;
+    ojc_read_buf_max = 0x00040000;
+    ojc_read_huge_pages = false;
+
+    // The buffer grows to hold a large value and shrinks again once only
+    // small values are read.
+    size_t	max;
+    size_t	last;
+    int		kind;
+
+    buf_sizes(300000, 1000000, &max, &kind, &last);
+    ut_true(300000 < max);
+    ut_same_int(BUF_MALLOC, kind, "buffer kind");
+    ut_true(last <= max / 16);
+
+    // A buffer of a huge page or more is mapped whether or not huge pages are
+    // reserved and it still shrinks back to an allocated one.
+    ojc_read_huge_pages = true;
+    buf_sizes(3000000, 5000000, &max, &kind, &last);
+    ojc_read_huge_pages = false;
+    ut_true(3000000 < max);
+    ut_same_int(BUF_MAP, kind, "huge buffer kind");
+    // The reader keeps 4 bytes of the mapping past end.
+    ut_same_int(0, (max + 4) % 0x00200000, "huge buffer size");
+    ut_true(last <= max / 16);
+    ut_true(last < 0x00200000);
+
+    // A token protected from the first byte of the buffer can only grow it.
+    struct _Reader	rd;
+    struct _Chunks	c;
+    const char		*p;
+    size_t		plen;
+
+    memset(json, 'y', 100000);
+    c.s = json;
+    c.end = json + 100000;
+    ojc_reader_init_func(&err, &rd, &c, chunk_read_func);
+    ojc_reader_span(&err, &rd, &p, &plen);
+    ut_true(rd.head == rd.tail);
+    while (ojc_reader_refill(&err, &rd, rd.tail)) {
+    }
+    ut_same_int(OJC_OK, err.code, "read error");
+    ut_true(rd.head == rd.tail);
+    ut_same_int(100000, rd.read_end - rd.tail, "bytes kept");
+    ojc_reader_cleanup(&rd);
+
+    // Lines dropped from the front of the buffer still count.
+    j = json;
+    *j++ = '[';
+    for (i = 0; i < 100000; i++) {
+	j += sprintf(j, "%d,\n", i);
+    }
+    strcpy(j, "  x]");
+    src = json;
+    ojc_parse_reader(&err, &src, burst_read_func, 0, 0);
+    ut_same_int(OJC_PARSE_ERR, err.code, "error code");
+    ut_true(NULL != strstr(err.msg, "line 100001, column 4 "));
+    free(json);
+}
 
-    fwrite(bench_json, sizeof(bench_json) - 1, 1, f);
-    fclose(f);
+// Strings that fill most of the ring wrap around it many times. The ring is
+// kept from growing so the input is many times its size.
+static void
+read_ring_test() {
+    struct _ojcErr	err = OJC_ERR_INIT;
+    struct _Reader	rd;
+    struct _Chunks	c;
+    ojcVal		val;
+    char		*json = (char*)malloc(2000000);
+    char		*j = json;
+    const char		*str;
+    const char		*p;
+    char		*prev;
+    char		key[16];
+    size_t		len;
+    int			wraps = 0;
+    int			bad = 0;
+    int			i;
+    int			k;
+
+    *j++ = '[';
+    for (i = 0; i < 600; i++) {
+	*j++ = '"';
+	for (k = 0; k < 3000 + i % 100; k++) {
+	    *j++ = 'a' + (i + k) % 26;
+	}
+	j += sprintf(j, "\",%d,", i);
+    }
+    strcpy(j, "true]");
+    ojc_read_ring = true;
+    ojc_read_buf_size = 0x00004000;
+    ojc_read_buf_max = 0x00004000;
+
+    // Reading it all through a reader shows the ring stays the same size and
+    // head goes back around to the start of the mapping.
+    c.s = json;
+    c.end = j + 5;
+    ojc_reader_init_func(&err, &rd, &c, chunk_read_func);
+    ut_same_int(BUF_RING, rd.free_head, "buffer kind");
+    prev = rd.head;
+    while (ojc_reader_span(&err, &rd, &p, &len)) {
+	rd.tail = rd.read_end;
+	if (rd.head < prev) {
+	    wraps++;
+	}
+	prev = rd.head;
+	if (0x00004000 != rd.end - rd.head + 4) {
+	    bad++;
+	}
+    }
+    ojc_reader_cleanup(&rd);
+    ut_same_int(0, bad, "ring resized");
+    ut_true(100 < wraps);
+
+    c.s = json;
+    val = ojc_parse_reader(&err, &c, chunk_read_func, 0, 0);
+    ojc_read_ring = false;
+    ojc_read_buf_size = 0x00001000;
+    ojc_read_buf_max = 0x00040000;
+    if (!ut_handle_error(&err)) {
+	ut_same_int(1201, ojc_member_count(&err, val), "member count");
+	for (i = 0; i < 600; i++) {
+	    sprintf(key, "%d", i * 2);
+	    str = ojc_str(&err, ojc_get(val, key));
+	    for (k = 0; k < 3000 + i % 100; k++) {
+		if ('a' + (i + k) % 26 != str[k]) {
+		    bad++;
+		    break;
+		}
+	    }
+	    if ('\0' != str[k]) {
+		bad++;
+	    }
+	}
+	ut_same_int(0, bad, "bad strings");
+	ojc_destroy(val);
+    }
+    free(json);
+}
+
+static void
+escape_sizes_test() {
+    struct _ojcErr	err = OJC_ERR_INIT;
+    ojcVal		val;
+    char		json[1024];
+    char		*j;
+    int			sizes[] = { 3, 10, 100, 200, 300, 0 };
+    int			*sp;
+    int			i;
+
+    // Each \\ unescapes to one character so the unescaped strings fall in a
+    // smaller size class than the escaped ones.
+    for (sp = sizes; 0 != *sp; sp++) {
+	j = json;
+	*j++ = '"';
+	for (i = 0; i < *sp; i++) {
+	    *j++ = '\\';
+	    *j++ = '\\';
+	}
+	strcpy(j, "\\u00e9\\ud83d\\ude00\"");
+	val = ojc_parse_str(&err, json, 0, 0);
+	if (ut_handle_error(&err)) {
+	    return;
+	}
+	ut_same_int(*sp + 6, ojc_str_len(&err, val), "string length");
+	ut_same("\\\\\\\xc3\xa9\xf0\x9f\x98\x80", ojc_str(&err, val) + *sp - 3);
+	ojc_destroy(val);
+
+	// and as a key
+	*json = '{';
+	json[1] = '"';
+	j = json + 2;
+	for (i = 0; i < *sp; i++) {
+	    *j++ = '\\';
+	    *j++ = 'n';
+	}
+	strcpy(j, "\":true}");
+	val = ojc_parse_str(&err, json, 0, 0);
+	if (ut_handle_error(&err)) {
+	    return;
+	}
+	ut_same_int(*sp, (int)strlen(ojc_key(ojc_members(&err, val))), "key length");
+	ojc_destroy(val);
+    }
+}
+
+static void
+borrow_test() {
+    struct _ojcErr	err = OJC_ERR_INIT;
+    const char		*json = "{\"a\":\"one\",\"\":\"\",\"long key that is over the inline size\":[\"two\",\"t\\u00e9\"]}";
+    const char		*expect = "{\"a\":\"one\",\"\":\"\",\"long key that is over the inline size\":[\"two\",\"t\xc3\xa9\"]}";
+    ojcVal		val;
+    ojcVal		dup;
+    ojcVal		m;
+    const char		*s;
+    char		*out;
+    int			len;
 
+    val = ojc_parse_borrow(&err, json, 0, 0);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    m = ojc_get(val, "a");
+    s = ojc_str_ref(&err, m, &len);
+    ut_true(json < s && s < json + strlen(json));
+    ut_same_int(3, len, "string length");
+    ut_same_int(1, ojc_key_len(m), "key length");
+    // The C string accessors do not change the value so they can not return
+    // a borrowed string that is not terminated.
+    ut_true(NULL == ojc_str(&err, m));
+    ut_same_int(OJC_TYPE_ERR, err.code, "unterminated string");
     ojc_err_init(&err);
-    f = fopen("tmp.json", "r");
-    val = ojc_parse_reader(&err, f, my_read_func, 0, 0);
-    fclose(f);
+    ut_true(s == ojc_str_ref(&err, m, &len));
+    ut_true(NULL == ojc_key(m));
+    m = ojc_get(val, "long key that is over the inline size");
+    s = ojc_key_ref(m, &len);
+    ut_true(json < s && s < json + strlen(json));
+    ut_same_int(37, len, "key length");
+    ut_true(NULL == ojc_key(m));
+    ut_same_int(3, ojc_str_len(&err, ojc_get(m, "0")), "string length");
+    // Escaped strings are still copied.
+    ut_same("t\xc3\xa9", ojc_str(&err, ojc_get(m, "1")));
+    ut_same_int(0, ojc_str_len(&err, ojc_get_member(&err, val, 1)), "empty string length");
+
+    out = ojc_to_str(val, 0);
+    ut_same(expect, out);
+    free(out);
+
+    dup = ojc_duplicate(val);
+    ut_true(ojc_equals(val, dup));
+    ut_same_int(0, ojc_cmp(val, dup), "compare");
+    ojc_destroy(val);
+    out = ojc_to_str(dup, 0);
+    ut_same(expect, out);
+    free(out);
+    ojc_destroy(dup);
+}
+
+static void
+insitu_test() {
+    struct _ojcErr	err = OJC_ERR_INIT;
+    char		buf[] = "{\"a\":\"one\",\"b\\tc\":[\"\",\"t\\u00e9 \\\"q\\\"\"],\"d\":12}";
+    ojcVal		val;
+    ojcVal		m;
+    char		*out;
+    char		part[sizeof(buf)];
+
+    // Only len bytes are parsed. The buffer is changed so use a copy.
+    memcpy(part, buf, sizeof(buf));
+    val = ojc_parse_insitu(&err, part, sizeof(part) - 3, 0, 0);
+    ut_same_int(OJC_INCOMPLETE_ERR, err.code, "incomplete");
+    ojc_destroy(val);
+
+    err.code = OJC_OK;
+    *err.msg = '\0';
+    val = ojc_parse_insitu(&err, buf, sizeof(buf) - 1, 0, 0);
     if (ut_handle_error(&err)) {
 	return;
     }
-    ojc_fill(&err, val, 0, result, sizeof(result));
+    m = ojc_get(val, "a");
+    ut_true(buf < ojc_str(&err, m) && ojc_str(&err, m) < buf + sizeof(buf));
+    ut_same("one", ojc_str(&err, m));
+    m = ojc_get_member(&err, val, 1);
+    ut_true(buf < ojc_key(m) && ojc_key(m) < buf + sizeof(buf));
+    ut_same("b\tc", ojc_key(m));
+    ut_same("", ojc_str(&err, ojc_get_member(&err, m, 0)));
+    m = ojc_get_member(&err, m, 1);
+    ut_true(buf < ojc_str(&err, m) && ojc_str(&err, m) < buf + sizeof(buf));
+    ut_same("t\xc3\xa9 \"q\"", ojc_str(&err, m));
+    ut_same_int(7, ojc_str_len(&err, m), "string length");
+
+    out = ojc_to_str(val, 0);
+    ut_same("{\"a\":\"one\",\"b\\tc\":[\"\",\"t\xc3\xa9 \\\"q\\\"\"],\"d\":12}", out);
+    free(out);
+    ojc_destroy(val);
 
-    ut_same(bench_json, result);
+    // Nothing follows the last byte so a word or number must not be read
+    // past it.
+    const char	*words[] = { "tru", "nul", "fals", "t", NULL };
+    char	*w;
+
+    for (const char **wp = words; NULL != *wp; wp++) {
+	size_t	len = strlen(*wp);
+
+	w = (char*)malloc(len);
+	memcpy(w, *wp, len);
+	err.code = OJC_OK;
+	*err.msg = '\0';
+	val = ojc_parse_insitu(&err, w, len, 0, 0);
+	ut_true(OJC_OK != err.code);
+	ojc_destroy(val);
+	free(w);
+    }
+    w = (char*)malloc(4);
+    memcpy(w, "true", 4);
+    err.code = OJC_OK;
+    val = ojc_parse_insitu(&err, w, 4, 0, 0);
+    ut_same_int(OJC_OK, err.code, "true");
+    ut_same_int(OJC_TRUE, ojc_type(val), "true type");
+    ojc_destroy(val);
+    free(w);
+
+    w = (char*)malloc(6);
+    memcpy(w, "1.5e-7", 6);
+    val = ojc_parse_insitu(&err, w, 6, 0, 0);
+    ut_same_int(OJC_OK, err.code, "number");
+    ut_true(1.5e-7 == ojc_double(&err, val));
+    ojc_destroy(val);
+    free(w);
+
+    // Escaped newlines are written as real ones but the error position is
+    // the same as for the unchanged input.
+    const char	*bad = "[\"a\\nb\\nc\",\n\"d\\n\"\n x]";
+    struct _ojcErr	serr = OJC_ERR_INIT;
+    char		ebuf[32];
+
+    ojc_destroy(ojc_parse_str(&serr, bad, 0, 0));
+    ut_true(NULL != strstr(serr.msg, "at line 3, column 3"));
+    strcpy(ebuf, bad);
+    err.code = OJC_OK;
+    *err.msg = '\0';
+    ojc_destroy(ojc_parse_insitu(&err, ebuf, strlen(ebuf), 0, 0));
+    ut_same_int(serr.code, err.code, "insitu error code");
+    ut_same_int((int)(strchr(serr.msg, '[') - serr.msg), (int)(strchr(err.msg, '[') - err.msg), "insitu error length");
+    ut_true(0 == strncmp(serr.msg, err.msg, strchr(serr.msg, '[') - serr.msg));
+}
+
+static void
+intern_test() {
+    struct _ojcErr	err = OJC_ERR_INIT;
+    ojcVal		v1;
+    ojcVal		v2;
+    ojcVal		obj;
+    char		*out;
+
+    ojc_intern_keys = true;
+    v1 = ojc_parse_str(&err, "{\"timestamp\":1,\"message\":\"one\",\"a\":true}", 0, 0);
+    v2 = ojc_parse_str(&err, "{\"message\":\"two\",\"timestamp\":2}", 0, 0);
+    if (ut_handle_error(&err)) {
+	return;
+    }
+    ut_true(ojc_key(ojc_get(v1, "timestamp")) == ojc_key(ojc_get(v2, "timestamp")));
+    ut_true(ojc_key(ojc_get(v1, "message")) == ojc_key(ojc_get(v2, "message")));
+    ut_same("two", ojc_str(&err, ojc_object_get_by_key(&err, v2, "message")));
+    ut_same_int(9, ojc_key_len(ojc_get(v2, "timestamp")), "key length");
+    ut_true(NULL == ojc_get(v2, "a"));
+    ut_true(NULL == ojc_get(v1, "timestam"));
+
+    // Keys set through the API are interned as well.
+    obj = ojc_create_object();
+    ojc_object_append(&err, obj, "message", ojc_create_str("three", 5));
+    ut_true(ojc_key(ojc_get(v1, "message")) == ojc_key(ojc_members(&err, obj)));
+    ojc_intern_keys = false;
+
+    // Keys that are not interned still match interned ones.
+    ojc_object_append(&err, obj, "timestamp", ojc_create_int(4));
+    ojc_merge(&err, obj, v1);
+    ut_same_int(OJC_OK, err.code, "merge");
+    out = ojc_to_str(obj, 0);
+    ut_same("{\"message\":\"one\",\"timestamp\":1,\"a\":true}", out);
+    free(out);
+    ojc_destroy(obj);
+    ojc_destroy(v1);
+    ojc_destroy(v2);
 }
 
+static void
+shape_test() {
+    struct _ojcErr	err = OJC_ERR_INIT;
+    ojcVal		val;
+    char		*out;
+    const char		*json = "["
+	"{\"level\":\"INFO\",\"a\":{\"x\":1,\"y\":2},\"timestamp\":1},"
+	"{\"level\":\"INFO\",\"a\":{\"x\":3,\"y\":4},\"timestamp\":2},"
+	"{\"level\":\"WARN\",\"a\":{\"y\":5,\"x\":6},\"timestamp\":3,\"extra\":true},"
+	"{\"lev\\u0065l\":\"INFO\",\"a\":{},\"a key that is too long to be remembered\":4},"
+	"{\"level\":\"INFO\",\"a\":{\"x\":7,\"y\":8},\"timestamp\":5}"
+	"]";
+    const char		*expect = "["
+	"{\"level\":\"INFO\",\"a\":{\"x\":1,\"y\":2},\"timestamp\":1},"
+	"{\"level\":\"INFO\",\"a\":{\"x\":3,\"y\":4},\"timestamp\":2},"
+	"{\"level\":\"WARN\",\"a\":{\"y\":5,\"x\":6},\"timestamp\":3,\"extra\":true},"
+	"{\"level\":\"INFO\",\"a\":{},\"a key that is too long to be remembered\":4},"
+	"{\"level\":\"INFO\",\"a\":{\"x\":7,\"y\":8},\"timestamp\":5}"
+	"]";
+    int			i;
+
+    // Predicted keys are used for the second object on. Run once with
+    // interned keys as well.
+    for (i = 0; i < 2; i++) {
+	ojc_intern_keys = (1 == i);
+	val = ojc_parse_str(&err, json, 0, 0);
+	if (ut_handle_error(&err)) {
+	    break;
+	}
+	out = ojc_to_str(val, 0);
+	ut_same(expect, out);
+	free(out);
+	ut_same_int(6, ojc_int(&err, ojc_get(val, "2/a/x")), "2/a/x");
+	ut_same_int(5, ojc_int(&err, ojc_get(val, "4/timestamp")), "4/timestamp");
+	ojc_destroy(val);
+    }
+    ojc_intern_keys = false;
+}
 
 static void
 file_write_test() {
@@ -946,6 +2604,54 @@ free_benchmark_test() {
     ut_benchmark("parse and free callback", 100000LL, free_bench, json);
 }
 
+static void
+create_bench(int64_t iter, void *ctx) {
+    ojcVal	*vals = (ojcVal*)ctx;
+
+    for (; 0 < iter; iter--) {
+	*vals++ = ojc_create_int(iter);
+    }
+}
+
+// The ctx is the JSON followed by where to put the parsed value.
+static void
+array_bench(int64_t iter, void *ctx) {
+    struct _ojcErr	err = OJC_ERR_INIT;
+    void		**args = (void**)ctx;
+
+    args[1] = ojc_parse_str(&err, (const char*)args[0], 0, 0);
+}
+
+// Values are made with nothing freed so none come from the cache.
+static void
+create_benchmark_test() {
+    int		cnt = 2000000;
+    ojcVal	*vals = (ojcVal*)malloc(sizeof(ojcVal) * cnt);
+    char	*json = (char*)malloc(2 * cnt + 2);
+    char	*s = json;
+    void	*args[2] = { json, NULL };
+
+    ojc_cleanup();
+    ut_benchmark("create", cnt, create_bench, vals);
+    for (int i = 0; i < cnt; i++) {
+	ojc_destroy(vals[i]);
+    }
+    free(vals);
+
+    *s++ = '[';
+    for (int i = cnt; 0 < i; i--) {
+	*s++ = '1';
+	*s++ = ',';
+    }
+    s[-1] = ']';
+    *s = '\0';
+    ojc_cleanup();
+    ut_benchmark("parse array", cnt, array_bench, args);
+    ut_same_int(cnt, ojc_member_count(NULL, (ojcVal)args[1]), "members");
+    ojc_destroy((ojcVal)args[1]);
+    free(json);
+}
+
 static void
 each_str255_benchmark_test() {
     int		cnt = 1000;
@@ -986,14 +2692,36 @@ static struct _Test	tests[] = {
     { "string",		string_test },
     { "word",		word_test },
     { "number",		number_test },
+    { "decimal",	decimal_test },
     { "opaque",		opaque_test },
     { "object",		object_test },
     { "mix",		mix_test },
     { "comment",	comment_test },
+    { "index",		index_test },
     { "each",		each_test },
+    { "parser",		parser_test },
     { "file_parse",	file_parse_test },
+    { "path_parse",	path_parse_test },
+    { "uring_parse",	uring_parse_test },
     { "follow_parse",	follow_parse_test },
+    { "follow_rotate",	follow_rotate_test },
     { "func_parse",	func_parse_test },
+    { "read_ahead",	read_ahead_test },
+    { "lend_parse",	lend_parse_test },
+    { "parallel",	parallel_test },
+    { "split_parse",	split_parse_test },
+    { "val_cache",	val_cache_test },
+    { "destroy_async",	destroy_async_test },
+    { "dispatch",	dispatch_test },
+    { "pretty_parse",	pretty_parse_test },
+    { "long_str",	long_str_test },
+    { "read_buf",	read_buf_test },
+    { "read_ring",	read_ring_test },
+    { "escape_sizes",	escape_sizes_test },
+    { "borrow",		borrow_test },
+    { "insitu",		insitu_test },
+    { "intern",		intern_test },
+    { "shape",		shape_test },
     { "file_write",	file_write_test },
     { "fill_too_big",	fill_too_big_test },
     { "array_get",	array_get_test },
@@ -1016,6 +2744,7 @@ static struct _Test	tests[] = {
     { "benchmark",	benchmark_test },
     { "each_benchmark",	each_benchmark_test },
     { "free_benchmark",	free_benchmark_test },
+    { "create_benchmark",	create_benchmark_test },
     { "each_str255_benchmark",	each_str255_benchmark_test },
     { "each_str257_benchmark",	each_str257_benchmark_test },
 